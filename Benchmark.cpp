@@ -0,0 +1,480 @@
+// Benchmarks for the graph engine.
+//
+//   g++ -std=c++17 -O2 -pthread Benchmark.cpp -o Benchmark
+//   ./Benchmark [nodes] [averageDegree] [maxThreads]
+//   ./Benchmark --suite [--nodes N] [--degree D] [--labels Person:3,Company:1] [--properties P]
+//                       [--skew a,b,c] [--operations N] [--seed S]
+//
+// Scaling (the default) builds a synthetic power-law graph (Chung-Lu: both endpoints of every
+// relationship are drawn with probability proportional to a node weight (i + 1)^-0.9, so a few
+// hubs collect most of the relationships, as in social and transaction graphs) and times a
+// whole-graph EXPAND_STATS from the largest hub: once with the single-threaded BFS, then with the
+// parallel engine on 1, 2, 4 ... maxThreads threads. Every run must reach the same levels.
+//
+// The suite (--suite) generates an R-MAT graph and drives it through Graph::interpretQuery, query
+// by query, exactly as the front ends do: it builds the graph with ADD_ENTITY, ADD_PROPERTY, ADD_r
+// and ADD_r_PROPERTY, runs every read query on random entities and relationships, then deletes
+// some of them. It prints one JSON document with the throughput and the p50/p99/p999 latency of
+// each command, so runs before and after a change can be compared line by line.
+
+#define DATABASE_NO_MAIN
+#include "Database.cpp"
+
+#include <cmath>
+#include <random>
+#include <sstream>
+
+namespace
+{
+    string nodeName(size_t i)
+    {
+        return "n" + to_string(i);
+    }
+
+    void buildPowerLawGraph(Graph &graph, size_t nodes, size_t averageDegree, uint64_t seed)
+    {
+        vector<double> weights(nodes);
+        for (size_t i = 0; i < nodes; ++i)
+        {
+            weights[i] = pow(double(i + 1), -0.9);
+        }
+        discrete_distribution<size_t> endpoint(weights.begin(), weights.end());
+        mt19937_64 random(seed);
+
+        // The graph acknowledges every insert; nobody reads that here
+        out.setMuted(true);
+        graph.reserve(nodes, nodes * averageDegree);
+        for (size_t i = 0; i < nodes; ++i)
+        {
+            graph.addNode("Account", nodeName(i));
+        }
+        for (size_t e = 0; e < nodes * averageDegree; ++e)
+        {
+            size_t from = endpoint(random), to = endpoint(random);
+            if (from != to)
+            {
+                graph.addRelationship(nodeName(from), nodeName(to), e % 2 ? "Pays" : "Knows");
+            }
+        }
+        out.setMuted(false);
+    }
+
+    // Runs one query and returns its response instead of printing it
+    string answer(Graph &graph, const string &query)
+    {
+        string response;
+        out.capture(&response);
+        graph.interpretQuery(query);
+        out.capture(nullptr);
+        return response;
+    }
+
+    // The "levels" part of an EXPAND_STATS response, which must not depend on the thread count
+    string levelsOf(const string &response)
+    {
+        size_t begin = response.find("\"levels\"");
+        return response.substr(begin, response.find(']', begin) - begin + 1);
+    }
+
+    // Median wall time of `repetitions` runs of the query, in milliseconds
+    double medianMilliseconds(Graph &graph, const string &query, size_t repetitions, string &response)
+    {
+        vector<double> times;
+        for (size_t r = 0; r < repetitions; ++r)
+        {
+            auto started = chrono::steady_clock::now();
+            response = answer(graph, query);
+            times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+        }
+        sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+
+    struct SuiteOptions
+    {
+        size_t nodes = 100000;
+        size_t degree = 8; // Relationships drawn per entity (self-relationships and repeats are dropped)
+        vector<pair<string, double>> labels = {{"Person", 3}, {"Company", 1}, {"City", 1}};
+        size_t properties = 3; // Integer properties P0, P1 ... per entity, uniform in [0, 100)
+        double skew[3] = {0.57, 0.19, 0.19}; // R-MAT quadrant probabilities a, b, c (d is the rest)
+        size_t operations = 1000; // Runs of each read query; whole-graph queries run fewer
+        uint64_t seed = 42;
+    };
+
+    // Parses "--key value" pairs. Returns false on an unknown key or a malformed value.
+    bool parseSuiteOptions(int argc, char *argv[], SuiteOptions &options)
+    {
+        try
+        {
+            for (int i = 2; i + 1 < argc; i += 2)
+            {
+                string key = argv[i], value = argv[i + 1];
+                if (key == "--nodes")
+                {
+                    options.nodes = stoul(value);
+                }
+                else if (key == "--degree")
+                {
+                    options.degree = stoul(value);
+                }
+                else if (key == "--properties")
+                {
+                    options.properties = stoul(value);
+                }
+                else if (key == "--operations")
+                {
+                    options.operations = stoul(value);
+                }
+                else if (key == "--seed")
+                {
+                    options.seed = stoull(value);
+                }
+                else if (key == "--skew")
+                {
+                    char comma;
+                    istringstream fields(value);
+                    fields >> options.skew[0] >> comma >> options.skew[1] >> comma >> options.skew[2];
+                    if (!fields || options.skew[0] + options.skew[1] + options.skew[2] > 1)
+                    {
+                        return false;
+                    }
+                }
+                else if (key == "--labels")
+                {
+                    options.labels.clear();
+                    istringstream fields(value);
+                    string field;
+                    while (getline(fields, field, ','))
+                    {
+                        size_t colon = field.find(':');
+                        options.labels.emplace_back(field.substr(0, colon), colon == string::npos ? 1.0 : stod(field.substr(colon + 1)));
+                    }
+                }
+                else
+                {
+                    return false;
+                }
+            }
+        }
+        catch (const exception &)
+        {
+            return false;
+        }
+        return argc % 2 == 0 && options.nodes >= 2 && !options.labels.empty();
+    }
+
+    // Draws the endpoints of one R-MAT relationship among 2^scale ids: the adjacency matrix is
+    // split into quadrants again and again, taking the top-left one with probability a, the
+    // top-right b, the bottom-left c and the bottom-right the rest, which fixes one bit of both
+    // endpoints per level. The larger a is against d, the more the degrees are skewed towards a
+    // few hubs.
+    pair<size_t, size_t> rmatEdge(size_t scale, const double skew[3], mt19937_64 &random)
+    {
+        uniform_real_distribution<double> unit(0, 1);
+        size_t from = 0, to = 0;
+        for (size_t level = 0; level < scale; ++level)
+        {
+            double p = unit(random);
+            from = from << 1 | (p >= skew[0] + skew[1]);
+            to = to << 1 | ((p >= skew[0] && p < skew[0] + skew[1]) || p >= skew[0] + skew[1] + skew[2]);
+        }
+        return {from, to};
+    }
+
+    // Times queries through Graph::interpretQuery and keeps every latency per command
+    class CommandTimer
+    {
+        struct Command
+        {
+            string name;
+            vector<double> microseconds;
+            double seconds = 0;
+        };
+
+        Graph &graph;
+        vector<Command> commands; // In the order they first ran
+        unordered_map<string, size_t> positions;
+        string response;
+
+    public:
+        explicit CommandTimer(Graph &graph) : graph(graph) {}
+
+        // Runs one query and books its time under `name`, by default its command (the text before
+        // '{' or a space)
+        void run(const string &query, string name = string())
+        {
+            if (name.empty())
+            {
+                name = query.substr(0, query.find_first_of("{ "));
+            }
+            auto position = positions.try_emplace(name, commands.size()).first;
+            if (position->second == commands.size())
+            {
+                commands.push_back({name, {}, 0});
+            }
+
+            response.clear();
+            out.capture(&response);
+            auto started = chrono::steady_clock::now();
+            graph.interpretQuery(query);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+            out.capture(nullptr);
+
+            Command &command = commands[position->second];
+            command.microseconds.push_back(seconds * 1e6);
+            command.seconds += seconds;
+        }
+
+        // The "commands" array of the report, one command per line
+        void print()
+        {
+            printf("  \"commands\": [");
+            for (size_t i = 0; i < commands.size(); ++i)
+            {
+                vector<double> &latencies = commands[i].microseconds;
+                sort(latencies.begin(), latencies.end());
+                auto percentile = [&](double q)
+                {
+                    return latencies[min(latencies.size() - 1, size_t(q * latencies.size()))];
+                };
+                printf("%s\n    {\"command\": \"%s\", \"operations\": %zu, \"seconds\": %.6f, \"per_second\": %.1f, "
+                       "\"p50_us\": %.2f, \"p99_us\": %.2f, \"p999_us\": %.2f, \"max_us\": %.2f}",
+                       i ? "," : "", commands[i].name.c_str(), latencies.size(), commands[i].seconds,
+                       latencies.size() / commands[i].seconds, percentile(0.5), percentile(0.99), percentile(0.999), latencies.back());
+            }
+            printf("\n  ]\n");
+        }
+    };
+
+    int runSuite(const SuiteOptions &options)
+    {
+        mt19937_64 random(options.seed);
+        Graph graph;
+        CommandTimer timer(graph);
+        size_t nodes = options.nodes;
+        auto anyNode = [&]
+        {
+            return nodeName(uniform_int_distribution<size_t>(0, nodes - 1)(random));
+        };
+        auto anyValue = [&]
+        {
+            return to_string(uniform_int_distribution<int>(0, 99)(random));
+        };
+        const string relations[] = {"Knows", "Follows", "Pays"};
+        const string &mainLabel = options.labels[0].first;
+        size_t heavyOperations = max<size_t>(1, options.operations / 250);
+
+        // Build: entities with their labels and properties, then the R-MAT relationships, each
+        // with a weight for SHORTEST_PATH
+        auto started = chrono::steady_clock::now();
+        vector<double> labelWeights;
+        for (const auto &label : options.labels)
+        {
+            labelWeights.push_back(label.second);
+        }
+        discrete_distribution<size_t> labelOf(labelWeights.begin(), labelWeights.end());
+        vector<size_t> labels(nodes);
+        graph.reserve(nodes, nodes * options.degree);
+        for (size_t i = 0; i < nodes; ++i)
+        {
+            labels[i] = labelOf(random);
+            timer.run("ADD_ENTITY{" + options.labels[labels[i]].first + "," + nodeName(i) + "}");
+        }
+        for (size_t i = 0; i < nodes && options.properties > 0; ++i)
+        {
+            string query = "ADD_PROPERTY{" + nodeName(i);
+            for (size_t p = 0; p < options.properties; ++p)
+            {
+                query += ",P" + to_string(p) + ":" + anyValue();
+            }
+            timer.run(query + "}");
+        }
+
+        size_t scale = 1;
+        while ((size_t(1) << scale) < nodes)
+        {
+            ++scale;
+        }
+        vector<pair<size_t, size_t>> edges;
+        for (size_t e = 0; e < nodes * options.degree; ++e)
+        {
+            auto edge = rmatEdge(scale, options.skew, random);
+            edge.first %= nodes;
+            edge.second %= nodes;
+            if (edge.first != edge.second)
+            {
+                timer.run("ADD_r{" + nodeName(edge.first) + "," + nodeName(edge.second) + "," + relations[e % 3] + "}");
+                edges.push_back(edge);
+            }
+        }
+        for (const auto &edge : edges)
+        {
+            timer.run("ADD_r_PROPERTY{" + nodeName(edge.first) + "," + nodeName(edge.second) + ",W:" + to_string(1 + random() % 9) + "}");
+        }
+        double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        auto anyEdge = [&]
+        {
+            return edges[uniform_int_distribution<size_t>(0, edges.size() - 1)(random)];
+        };
+        auto edgeArguments = [&](const pair<size_t, size_t> &edge)
+        {
+            return nodeName(edge.first) + "," + nodeName(edge.second);
+        };
+
+        // Indexes and columns the reads below can use
+        if (options.properties > 1)
+        {
+            timer.run("CREATE_INDEX{P0}");
+            timer.run("CREATE_RANGE_INDEX{P1}");
+            timer.run("CREATE_COLUMNS{" + mainLabel + ",P1}");
+            timer.run("PREPARE byValue AS MATCH{(a:" + mainLabel + ",P0:$1)-[Knows]->(b),LIMIT:20}");
+        }
+
+        // Reads on random entities and relationships
+        for (size_t i = 0; i < options.operations; ++i)
+        {
+            timer.run("GET_INFO{" + anyNode() + ",ALL}");
+            timer.run("FIND{" + anyNode() + ",ALL}");
+            timer.run("FIND_IN{" + anyNode() + ",ALL}");
+            timer.run("GET_r_INFO{" + edgeArguments(anyEdge()) + ",ALL}");
+            timer.run("EXPAND{" + anyNode() + ",2}");
+            timer.run("EXPAND_STATS{" + anyNode() + ",3}");
+            timer.run("PATH_EXISTS{" + anyNode() + "," + anyNode() + ",6}");
+            timer.run("SHORTEST_PATH{" + anyNode() + "," + anyNode() + ",W}");
+            timer.run("COMMON{" + anyNode() + "," + anyNode() + "}");
+            timer.run("TRIANGLES{" + anyNode() + "}");
+            timer.run("COMPONENT_OF{" + anyNode() + "}");
+            timer.run("SAME_COMPONENT{" + anyNode() + "," + anyNode() + "}");
+            if (options.properties > 1)
+            {
+                string value = anyValue();
+                timer.run("GET{P0:" + value + "}");
+                timer.run("GET{P1 BETWEEN " + value + " " + value + "}");
+                timer.run("SCAN{" + mainLabel + ",P1>=" + value + ",P1<=" + value + "}");
+                timer.run("MATCH{(a:" + mainLabel + ",P0:" + value + ")-[Knows]->(b)-[Follows]->(c),LIMIT:20}");
+                timer.run("EXECUTE byValue{" + value + "}");
+            }
+        }
+
+        // Queries over whole labels or the whole graph
+        for (size_t i = 0; i < heavyOperations; ++i)
+        {
+            timer.run("GET_LABELED{" + mainLabel + "}");
+            timer.run("COUNT{" + mainLabel + "-[Knows]->*}");
+            if (options.properties > 1)
+            {
+                timer.run("AGG{" + mainLabel + ",COUNT(*),AVG(P1),MAX(P1),GROUP_BY(P0)}");
+            }
+            timer.run("DEGREE{top:10}");
+            timer.run("COMPONENTS{1000}");
+            timer.run("PAGERANK{10,0.85,top:10}");
+            timer.run("PAGERANK_STORE{10,0.85,key:Rank}");
+            timer.run("TRIANGLES{*}", "TRIANGLES{*}");
+            timer.run("MEMORY_STATS{}");
+            timer.run("CACHE_STATS{}");
+        }
+
+        // Changes: properties, relationships and entities removed
+        for (size_t i = 0; i < options.operations && options.properties > 0; ++i)
+        {
+            timer.run("DELETE_INFO{" + anyNode() + ",P0}");
+        }
+        for (size_t i = 0; i < options.operations; ++i)
+        {
+            timer.run("DELETE_r_INFO{" + edgeArguments(anyEdge()) + ",W}");
+        }
+        for (size_t i = 0; i < options.operations; ++i)
+        {
+            timer.run("DELETE_r{" + edgeArguments(anyEdge()) + ",ALL}");
+        }
+        vector<size_t> victims(nodes);
+        iota(victims.begin(), victims.end(), 0);
+        shuffle(victims.begin(), victims.end(), random);
+        victims.resize(min(nodes / 2, options.operations));
+        for (size_t victim : victims)
+        {
+            timer.run("DELETE_ENTITY{" + options.labels[labels[victim]].first + "," + nodeName(victim) + "}");
+        }
+
+        printf("{\n");
+        printf("  \"nodes\": %zu, \"degree\": %zu, \"properties\": %zu, \"operations\": %zu, \"seed\": %llu,\n",
+               nodes, options.degree, options.properties, options.operations, static_cast<unsigned long long>(options.seed));
+        printf("  \"skew\": [%g, %g, %g, %g],\n", options.skew[0], options.skew[1], options.skew[2],
+               1 - options.skew[0] - options.skew[1] - options.skew[2]);
+        printf("  \"labels\": {");
+        for (size_t i = 0; i < options.labels.size(); ++i)
+        {
+            printf("%s\"%s\": %g", i ? ", " : "", options.labels[i].first.c_str(), options.labels[i].second);
+        }
+        printf("},\n");
+        printf("  \"relationships_drawn\": %zu, \"build_seconds\": %.3f,\n", edges.size(), buildSeconds);
+        timer.print();
+        printf("}\n");
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && string(argv[1]) == "--suite")
+    {
+        SuiteOptions options;
+        if (!parseSuiteOptions(argc, argv, options))
+        {
+            fprintf(stderr, "usage: Benchmark --suite [--nodes N] [--degree D] [--labels Person:3,Company:1] [--properties P] [--skew a,b,c] [--operations N] [--seed S]\n");
+            return 1;
+        }
+        return runSuite(options);
+    }
+
+    size_t nodes = argc > 1 ? stoul(argv[1]) : 200000;
+    size_t averageDegree = argc > 2 ? stoul(argv[2]) : 16;
+    size_t maxThreads = max<size_t>(1, argc > 3 ? stoul(argv[3]) : thread::hardware_concurrency());
+    const size_t Repetitions = 5;
+
+    Graph graph;
+    auto started = chrono::steady_clock::now();
+    buildPowerLawGraph(graph, nodes, averageDegree, 42);
+    double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    printf("graph: %zu nodes, ~%zu relationships, built in %.1f s\n", nodes, nodes * averageDegree, buildSeconds);
+
+    // The largest hub is node 0; follow relationships of every type as deep as they go
+    string query = "EXPAND_STATS{" + nodeName(0) + ",1000}";
+    string response;
+
+    graph.setWorkerPool(nullptr);
+    double sequential = medianMilliseconds(graph, query, Repetitions, response);
+    string expected = levelsOf(response);
+    printf("%s", response.c_str());
+    printf("%-12s %10s %10s\n", "threads", "ms", "speedup");
+    printf("%-12s %10.1f %10s\n", "sequential", sequential, "-");
+
+    // 1, 2, 4 ... threads, always ending with maxThreads itself
+    vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < maxThreads; threads *= 2)
+    {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    double single = 0;
+    for (size_t threads : threadCounts)
+    {
+        WorkerPool pool(threads - 1);
+        graph.setWorkerPool(&pool, 0); // Parallel engine from the first level on
+        double milliseconds = medianMilliseconds(graph, query, Repetitions, response);
+        graph.setWorkerPool(nullptr);
+        if (threads == 1)
+        {
+            single = milliseconds;
+        }
+
+        if (levelsOf(response) != expected)
+        {
+            printf("threads %zu reached different levels: %s\n", threads, response.c_str());
+            return 1;
+        }
+        printf("%-12zu %10.1f %10.2f\n", threads, milliseconds, single / milliseconds);
+    }
+    return 0;
+}
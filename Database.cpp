@@ -2,82 +2,411 @@
 #include <iostream>
 #include <unordered_map>
 #include <string>
-#include <sstream> // For stringstream
+#include <string_view>
 #include <iomanip> // For std::setw and std::setfill
 #include <unordered_set>
+#include <set>
 #include <vector>
+#include <deque>
+#include <list>
 #include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <cmath>
+#include <cctype>
+#include <charconv>
+#include <type_traits>
+#include <fstream>
+#include <chrono>
+#include <filesystem>
+#ifdef _WIN32
+#include <io.h> // For _commit
+#else
+#include <fcntl.h>    // For open
+#include <unistd.h>   // For fsync
+#include <sys/mman.h> // For mmap
+#include <sys/stat.h> // For fstat
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <csignal>
+#include <cerrno>
+#endif
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <shared_mutex>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#ifdef _MSC_VER
+#include <intrin.h> // For _BitScanForward64
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h> // For intersectSorted
+#endif
 
 using namespace std;
 
+// All query responses are written through this buffer instead of straight to cout. Writing
+// `endl` to cout flushes on every line, so one GET_INFO could cost several write syscalls; here
+// responses accumulate in a reusable buffer and main() flushes once per batch of queries, when
+// no further input is waiting (or after every query in --interactive mode).
+class ResponseWriter
+{
+    string buffer;
+    bool muted = false;
+    string *captured = nullptr;
+
+    // Flush early if a single batch produces this much output, to bound memory
+    static const size_t FlushThreshold = 1 << 20;
+
+    void append(const char *data, size_t size)
+    {
+        if (muted)
+        {
+            return;
+        }
+        if (captured)
+        {
+            captured->append(data, size);
+            return;
+        }
+        buffer.append(data, size);
+        if (buffer.size() >= FlushThreshold)
+        {
+            flush();
+        }
+    }
+
+public:
+    ResponseWriter()
+    {
+        buffer.reserve(64 * 1024);
+    }
+
+    ResponseWriter &operator<<(string_view text)
+    {
+        append(text.data(), text.size());
+        return *this;
+    }
+
+    ResponseWriter &operator<<(const string &text)
+    {
+        append(text.data(), text.size());
+        return *this;
+    }
+
+    ResponseWriter &operator<<(const char *text)
+    {
+        append(text, char_traits<char>::length(text));
+        return *this;
+    }
+
+    ResponseWriter &operator<<(char c)
+    {
+        append(&c, 1);
+        return *this;
+    }
+
+    // Numbers are formatted with to_chars, without locale or stream state
+    template <typename T, typename = enable_if_t<is_arithmetic<T>::value>>
+    ResponseWriter &operator<<(T value)
+    {
+        char digits[64];
+        auto result = to_chars(digits, digits + sizeof(digits), value);
+        append(digits, result.ptr - digits);
+        return *this;
+    }
+
+    // Accepts `endl` so handlers keep their familiar look; it only ends the line; flushing is up to main()
+    ResponseWriter &operator<<(ostream &(*)(ostream &))
+    {
+        append("\n", 1);
+        return *this;
+    }
+
+    // While muted (e.g. when replaying the write-ahead log) responses are dropped
+    void setMuted(bool mute)
+    {
+        muted = mute;
+    }
+
+    // While `target` is set, responses are appended to it instead of going to stdout, so a query
+    // run on a worker thread can be answered in its original position (nullptr ends the capture)
+    void capture(string *target)
+    {
+        captured = target;
+    }
+
+    // Writes everything buffered so far to stdout, keeping the buffer's capacity for reuse
+    void flush()
+    {
+        if (!buffer.empty())
+        {
+            fwrite(buffer.data(), 1, buffer.size(), stdout);
+            buffer.clear();
+        }
+        fflush(stdout);
+    }
+};
+
+// One writer per thread, so queries running on different threads never interleave their output
+thread_local ResponseWriter out;
+
+// Dense internal identifier of a node. Names are translated to ids once at the query boundary,
+// everything inside Graph (adjacency, edge index) works on ids only.
+using NodeId = uint32_t;
+const NodeId InvalidNode = UINT32_MAX;
+
+// Small integer handle of an interned string. Labels, relationship types and property keys
+// repeat across millions of entities, so each distinct text is stored once in the symbol table
+// and everything else holds (and compares) the handle. Only queries holding Graph's exclusive
+// lock intern new strings; readers use find() and name(), which never modify the table.
+using Symbol = uint32_t;
+const Symbol NoSymbol = UINT32_MAX;
+
+class SymbolTable
+{
+    // Text -> handle, used when a query names a label, relation or key
+    unordered_map<string, Symbol> ids;
+
+    // Handle -> text, used when printing. A deque keeps references stable as it grows.
+    deque<string> names;
+
+public:
+    // Returns the handle of `text`, adding it to the table on first use
+    Symbol intern(const string &text)
+    {
+        auto it = ids.find(text);
+        if (it != ids.end())
+        {
+            return it->second;
+        }
+        Symbol symbol = names.size();
+        names.push_back(text);
+        ids.emplace(text, symbol);
+        return symbol;
+    }
+
+    // Returns the handle of `text` without adding it, or NoSymbol if it was never interned.
+    // Read-only queries use this so that looking up unknown names does not grow the table.
+    Symbol find(const string &text) const
+    {
+        auto it = ids.find(text);
+        return it != ids.end() ? it->second : NoSymbol;
+    }
+
+    // Returns the text of an interned handle
+    const string &name(Symbol symbol) const
+    {
+        return names[symbol];
+    }
+
+    // Number of interned strings; handles run from 0 to size() - 1
+    Symbol size() const
+    {
+        return names.size();
+    }
+};
+
+// Interned labels, relationship types and property keys shared by all entities
+SymbolTable symbols;
+
+// Type of a property value, decided once when the value is set
+enum class ValueType : uint8_t
+{
+    Boolean, // "true" or "false"
+    Integer, // Whole number that fits in 64 bits, e.g. "30" or "-7"
+    Real,    // Any other finite number, e.g. "1.85" or "2e3"
+    Text     // Everything else
+};
+
+// A node property value: the text as it was written (which is what queries print and
+// equality compares) plus its typed form, so comparisons need no parsing
+struct PropertyValue
+{
+    string text;
+    ValueType type = ValueType::Text;
+    union
+    {
+        bool boolean;
+        int64_t integer;
+        double real;
+    };
+
+    PropertyValue() : integer(0) {}
+    explicit PropertyValue(const string &value) : integer(0)
+    {
+        assign(value);
+    }
+
+    void assign(const string &value)
+    {
+        text = value;
+        const char *begin = text.data(), *end = text.data() + text.size();
+        if (text == "true" || text == "false")
+        {
+            type = ValueType::Boolean;
+            boolean = text == "true";
+        }
+        else if (!text.empty() && from_chars(begin, end, integer).ptr == end)
+        {
+            type = ValueType::Integer;
+        }
+        else if (!text.empty() && from_chars(begin, end, real).ptr == end && std::isfinite(real))
+        {
+            type = ValueType::Real;
+        }
+        else
+        {
+            type = ValueType::Text;
+        }
+    }
+
+    bool isNumber() const
+    {
+        return type == ValueType::Integer || type == ValueType::Real;
+    }
+
+    double number() const
+    {
+        return type == ValueType::Integer ? static_cast<double>(integer) : real;
+    }
+
+    // Values only compare within one kind: booleans, numbers (whole or not) and text, ordered in
+    // that sequence when kinds differ
+    int kind() const
+    {
+        return type == ValueType::Boolean ? 0 : isNumber() ? 1 : 2;
+    }
+
+    // The value every other value of `kind` compares greater than or equal to
+    static PropertyValue lowest(int kind)
+    {
+        PropertyValue value; // Empty text
+        if (kind == 0)
+        {
+            value.type = ValueType::Boolean;
+            value.boolean = false;
+        }
+        else if (kind == 1)
+        {
+            value.type = ValueType::Real;
+            value.real = -numeric_limits<double>::infinity();
+        }
+        return value;
+    }
+};
+
+// Orders two values: negative, zero or positive like strcmp
+inline int compareValues(const PropertyValue &a, const PropertyValue &b)
+{
+    if (a.kind() != b.kind())
+    {
+        return a.kind() < b.kind() ? -1 : 1;
+    }
+    switch (a.type)
+    {
+    case ValueType::Boolean:
+        return int(a.boolean) - int(b.boolean);
+    case ValueType::Text:
+        return a.text.compare(b.text);
+    default:
+        if (a.type == ValueType::Integer && b.type == ValueType::Integer)
+        {
+            return a.integer < b.integer ? -1 : a.integer > b.integer;
+        }
+        return a.number() < b.number() ? -1 : a.number() > b.number();
+    }
+}
+
 class Node
 {
 public:
     // Each node represents an entity. The label indicates the type of entity,
     // such as "Person", "Car", "Organization", etc.
-    string label;
+    Symbol label;
 
     // Unique identifier for the node, typically a name or ID.
     string name;
 
+    // Slot of the node in Graph's node table, assigned by Graph::addNode
+    NodeId id = InvalidNode;
+
+    // Row of the node in its label's LabelTable, if the label has one
+    uint32_t labelSlot = UINT32_MAX;
+
     // A map to store various properties of the node.
-    // The key is the property name (string) and the value is the property value (string).
-    unordered_map<string, string> properties;
+    // The key is the interned property name and the value is the typed property value.
+    unordered_map<Symbol, PropertyValue> properties;
 
     // Constructor to initialize a node with a label and name.
-    Node(const string &label, const string &name) : label(label), name(name) {}
+    Node(Symbol label, const string &name) : label(label), name(name) {}
 
     // Function to add or update a property. This method allows setting properties
     // dynamically based on key-value pairs, making it flexible for different entities.
-    void updateProperty(const string &key, const string &value)
+    void updateProperty(Symbol key, const string &value)
     {
-        properties[key] = value;
+        properties[key].assign(value);
     }
 
     // Function to get a specific property by key.
     // If the property exists, it prints its value in a formatted JSON style.
     void getProperty(const string &key) const
     {
-        auto it = properties.find(key);
+        auto it = properties.find(symbols.find(key));
         if (it != properties.end())
         {
-            cout << "\"" << key << "\": \"" << it->second << "\"" << endl;
+            out << "\"" << key << "\": \"" << it->second.text << "\"" << endl;
         }
         else
         {
-            cout << "\"" << key << "\": null" << endl; // If the property does not exist
+            out << "\"" << key << "\": null" << endl; // If the property does not exist
         }
     }
 
     // Function to print all node properties in a readable JSON format.
     void printProperties() const
     {
-        cout << "{" << endl;
-        cout << "  \"Label\": \"" << label << "\"," << endl;
-        cout << "  \"Name\": \"" << name << "\"," << endl;
+        out << "{" << endl;
+        out << "  \"Label\": \"" << symbols.name(label) << "\"," << endl;
+        out << "  \"Name\": \"" << name << "\"," << endl;
 
         // Print all properties stored in the unordered_map
-        cout << "  \"Properties\": {" << endl;
+        out << "  \"Properties\": {" << endl;
 
         // Use an iterator to keep track of whether we're at the last element
         auto it = properties.begin();
         for (size_t i = 0; i < properties.size(); ++i, ++it)
         {
-            cout << "    \"" << it->first << "\": \"" << it->second << "\"";
+            out << "    \"" << symbols.name(it->first) << "\": \"" << it->second.text << "\"";
             // Check if we're not at the last element
             if (i < properties.size() - 1)
             {
-                cout << ",";
+                out << ",";
             }
-            cout << endl;
+            out << endl;
         }
-        cout << "  }" << endl;
-        cout << "}" << endl;
+        out << "  }" << endl;
+        out << "}" << endl;
     }
 
     // Function to delete a specific property by key.
     // This method removes the property if it exists in the properties map.
-    void deleteProperty(const string &key)
+    void deleteProperty(Symbol key)
     {
         auto it = properties.find(key);
         if (it != properties.end())
@@ -86,7 +415,7 @@ public:
         }
         else
         {
-            cout << "Property \"" << key << "\" does not exist." << endl; // If the property does not exist
+            out << "Property \"" << symbols.name(key) << "\" does not exist." << endl; // If the property does not exist
         }
     }
 
@@ -102,17 +431,24 @@ class Relationship
 {
 public:
     // This class represents a relationship between two nodes, like "friends", "purchased", "likes", etc.
-    string relation;
+    Symbol relation;
 
-    // Properties of the relationship
-    unordered_map<string, string> properties;
+    // Properties of the relationship, keyed by interned property name
+    unordered_map<Symbol, string> properties;
+
+    // Endpoints of the relationship and its position in the source's outgoing and the
+    // target's incoming adjacency lists, so Graph can unlink it without searching.
+    NodeId from = InvalidNode;
+    NodeId to = InvalidNode;
+    uint32_t outSlot = 0;
+    uint32_t inSlot = 0;
 
     // Constructor to initialize a relationship with a specific relation type
-    Relationship(const string &relationType)
+    Relationship(Symbol relationType)
         : relation(relationType) {}
 
     // Method to update or add a property of the relationship
-    void setProperty(const string &key, const string &value)
+    void setProperty(Symbol key, const string &value)
     {
         properties[key] = value;
     }
@@ -120,14 +456,14 @@ public:
     // Method to remove a specific property by key
     void removeProperty(const string &key)
     {
-        auto it = properties.find(key);
+        auto it = properties.find(symbols.find(key));
         if (it != properties.end())
         {
             properties.erase(it); // Remove the specific property
         }
         else
         {
-            cout << "{\"error\":\"Property \"" << key << "\" does not exist.\"}" << endl;
+            out << "{\"error\":\"Property \"" << key << "\" does not exist.\"}" << endl;
         }
     }
 
@@ -135,11 +471,11 @@ public:
     void clearProperties()
     {
         properties.clear();
-        cout << "{\"status\": \"success\", \"message\": \"All properties have been cleared.\"" << endl;
+        out << "{\"status\": \"success\", \"message\": \"All properties have been cleared.\"" << endl;
     }
 
     // Method to retrieve a property value by key
-    string getProperty(const string &key) const
+    string getProperty(Symbol key) const
     {
         auto it = properties.find(key);
         if (it != properties.end())
@@ -152,1369 +488,7752 @@ public:
     // Method to print the relationship information
     void displayRelationship() const
     {
-        cout << "{\n  \"relationship\": " << relation << endl;
+        out << "{\n  \"relationship\": " << symbols.name(relation) << endl;
         if (!properties.empty())
         {
-            cout << "  \"properties\": {" << endl;
+            out << "  \"properties\": {" << endl;
             for (auto it = properties.begin(); it != properties.end(); ++it)
             {
-                cout << "  \"" << it->first << "\": \"" << it->second << "\"";
+                out << "  \"" << symbols.name(it->first) << "\": \"" << it->second << "\"";
                 if (std::next(it) != properties.end())
                 {
-                    cout << ","; // Add comma only if it's not the last element
+                    out << ","; // Add comma only if it's not the last element
                 }
-                cout << endl;
+                out << endl;
             }
-            cout << "  }" << "\n}" << endl;
+            out << "  }" << "\n}" << endl;
         }
         else
         {
-            cout << "No properties." << endl; // Indicate if no properties exist
+            out << "No properties." << endl; // Indicate if no properties exist
         }
     }
 };
 
-// Custom hash function for pairs
-struct pair_hash
+// 64-bit finalizer from SplitMix64: spreads every input bit over the whole result
+inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Packs a (from, to) node id pair into a single 64-bit edge key
+inline uint64_t edgeKey(NodeId from, NodeId to)
+{
+    return (static_cast<uint64_t>(from) << 32) | to;
+}
+
+// Custom hash function for edge keys. std::hash<uint64_t> is the identity on common
+// standard libraries, which would leave the low bits (the target id) alone to pick the bucket.
+struct edge_key_hash
 {
-    template <class T1, class T2>
-    std::size_t operator()(const std::pair<T1, T2> &pair) const
+    std::size_t operator()(uint64_t key) const
     {
-        auto hash1 = std::hash<T1>{}(pair.first);
-        auto hash2 = std::hash<T2>{}(pair.second);
-        return hash1 ^ hash2; // Combine hashes
+        return mix64(key);
     }
 };
 
-class Graph
+// One entry of an adjacency list: the node on the other side and the shared Relationship object
+struct Edge
 {
+    NodeId node;
+    Relationship *relationship;
+};
 
-    // Maps each node's unique name to its Node object for easy lookup.
-    unordered_map<string, Node *> nodes;
-
-    // Provides a label-based index for fast lookup of nodes by type.
-    // Each label (e.g., "Person") maps to a set of Node pointers that have that label.
-    unordered_map<string, unordered_set<Node *>> labelIndex;
+// Pooled allocator for Node and Relationship objects. Objects are carved out of large slabs
+// instead of one heap allocation each, which keeps bulk loads out of malloc and places
+// entities created together next to each other. Destroyed objects leave their slot on a
+// free list that the next create() reuses.
+template <typename T>
+class SlabPool
+{
+    // A free slot stores the free-list link in place of the object
+    union Slot
+    {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
 
-    // Stores relationships from a node to a set of pairs (to node name, Relationship*).
-    unordered_map<string, unordered_set<pair<string, Relationship *>, pair_hash>> relationships;
+    static const size_t SlotsPerSlab = 4096;
 
-public:
-    void addNode(const string &label, const string &name)
-    {
-        // Check if a node with the same name already exists
-        if (nodes.find(name) != nodes.end())
-        {
-            cout << "{\"error\": \"A Entity with the name \"" << name << "\" already exists.\"}" << endl;
-            return;
-        }
+    vector<Slot *> slabs;
+    Slot *freeList = nullptr;
+    size_t usedInLastSlab = SlotsPerSlab; // Forces a new slab on the first create()
 
-        // Create a new Node and add it to the nodes map
-        Node *newNode = new Node(label, name);
-        nodes[name] = newNode;
+    // Counters reported by MEMORY_STATS{}
+    size_t live = 0;
+    size_t created = 0;
+    size_t reused = 0;
 
-        // Insert the node into labelIndex for efficient lookup by label
-        labelIndex[label].insert(newNode);
+public:
+    SlabPool() = default;
+    SlabPool(const SlabPool &) = delete;
+    SlabPool &operator=(const SlabPool &) = delete;
 
-        // JSON feedback indicating successful addition
-        cout << "{\"status\": \"success\", \"message\": \"Entity with label \""
-             << label << "\" and name \"" << name << "\" added successfully.\"}" << endl;
+    ~SlabPool()
+    {
+        releaseAll();
     }
 
-    void addNodeProperty(const string &name, const string &key, const string &value)
+    // Constructs a T in a free slot, taking a new slab only when the free list is empty
+    template <typename... Args>
+    T *create(Args &&...args)
     {
-        // Check if node exists in the graph using its unique name
-        auto it = nodes.find(name);
-        if (it != nodes.end())
+        Slot *slot;
+        if (freeList)
         {
-            it->second->updateProperty(key, value); // Update node's property
+            slot = freeList;
+            freeList = freeList->next;
+            ++reused;
         }
         else
         {
-            cout << "{\"error\": \"Entity with name \"" << name << "\" does not exist.\"}" << endl;
+            if (usedInLastSlab == SlotsPerSlab)
+            {
+                slabs.push_back(static_cast<Slot *>(::operator new(sizeof(Slot) * SlotsPerSlab)));
+                usedInLastSlab = 0;
+            }
+            slot = &slabs.back()[usedInLastSlab++];
         }
+
+        T *object = new (slot->storage) T(std::forward<Args>(args)...);
+        ++live;
+        ++created;
+        return object;
     }
 
-    void getNodeProperty(const string &name, const vector<string> &keys)
+    // Destroys an object and puts its slot on the free list
+    void destroy(T *object)
     {
-        // Check if the node exists in the graph
-        if (nodes.find(name) == nodes.end())
+        object->~T();
+        Slot *slot = reinterpret_cast<Slot *>(object);
+        slot->next = freeList;
+        freeList = slot;
+        --live;
+    }
+
+    // Returns every slab to the system at once. Objects still alive are not destroyed,
+    // so the owner must run their destructors first if they hold resources.
+    void releaseAll()
+    {
+        for (Slot *slab : slabs)
         {
-            cout << "{\"error\": \"Entity \"" << name << "\" does not exist in the database.\"}" << endl;
-            return;
+            ::operator delete(slab);
         }
+        slabs.clear();
+        freeList = nullptr;
+        usedInLastSlab = SlotsPerSlab;
+        live = 0;
+    }
 
-        Node *node = nodes[name]; // Retrieve the node
+    size_t liveObjects() const { return live; }
+    size_t totalCreated() const { return created; }
+    size_t reusedSlots() const { return reused; }
+    size_t slabCount() const { return slabs.size(); }
+    size_t reservedBytes() const { return slabs.size() * SlotsPerSlab * sizeof(Slot); }
+};
 
-        // If "ALL" is specified in the keys, print all properties
-        if (keys.size() == 1 && keys[0] == "ALL")
+class PropertyIndex
+{
+    // For every indexed property key, maps each value to the set of nodes holding that value.
+    // Keys that were never passed to createIndex are not tracked at all.
+    unordered_map<Symbol, unordered_map<string, unordered_set<Node *>>> index;
+
+    // Orders range index entries by value, then node. An entry points at the value inside its
+    // node's property map, which stays put until the index has forgotten it.
+    struct RangeEntryLess
+    {
+        bool operator()(const pair<const PropertyValue *, Node *> &a, const pair<const PropertyValue *, Node *> &b) const
         {
-            node->printProperties();
-            return;
+            int order = compareValues(*a.first, *b.first);
+            return order != 0 ? order < 0 : less<Node *>()(a.second, b.second);
         }
+    };
+    using RangeIndex = set<pair<const PropertyValue *, Node *>, RangeEntryLess>;
 
-        // If specific keys are provided, iterate through each key and print each property
-        cout << "{\n";
-        cout << "  \"Label\": \"" << node->label << "\",\n";
-        cout << "  \"Name\": \"" << name << "\",\n";
-        cout << "  \"Properties\": {\n";
+    // For every key passed to createRangeIndex, its (value, node) pairs in value order
+    unordered_map<Symbol, RangeIndex> ranges;
 
-        bool firstProperty = true;
-        for (const auto &key : keys)
-        {
-            if (!firstProperty)
-            {
-                cout << ",\n";
-            }
-            cout << "    ";
-            node->getProperty(key); // Display each property
-            firstProperty = false;
-        }
+public:
+    // Returns true if lookups on this property key can be answered from the index
+    bool has(Symbol key) const
+    {
+        return index.find(key) != index.end();
+    }
 
-        cout << "\n  }\n";
-        cout << "}" << endl;
+    // Returns how many distinct values an indexed property key holds (0 if it is not indexed)
+    size_t distinctValues(Symbol key) const
+    {
+        auto it = index.find(key);
+        return it != index.end() ? it->second.size() : 0;
     }
 
-    void deleteNodeProperty(const string &name, const vector<string> &keys)
+    // Returns true if comparisons on this property key can be answered by a range scan
+    bool hasRange(Symbol key) const
     {
-        // Check if node exists
-        if (nodes.find(name) == nodes.end())
+        return ranges.find(key) != ranges.end();
+    }
+
+    // Returns every indexed property key (saved with snapshots)
+    vector<Symbol> indexedKeys() const
+    {
+        vector<Symbol> keys;
+        for (const auto &entry : index)
         {
-            cout << "{\"error\": \"Entity '" << name << "' not found in the database.\"}" << endl;
-            return;
+            keys.push_back(entry.first);
         }
+        return keys;
+    }
 
-        Node *node = nodes[name];
+    // Returns every property key with a range index (saved with snapshots)
+    vector<Symbol> rangeKeys() const
+    {
+        vector<Symbol> keys;
+        for (const auto &entry : ranges)
+        {
+            keys.push_back(entry.first);
+        }
+        return keys;
+    }
 
-        // Check if the keys contain "ALL"
-        if (keys.size() == 1 && keys[0] == "ALL")
+    // Starts indexing a property key and fills it from the given nodes.
+    // Returns false if the key was already indexed.
+    bool createIndex(Symbol key, const vector<Node *> &nodeTable)
+    {
+        if (has(key))
         {
-            // Clear all properties if "ALL" is specified
-            node->clearProperties();
-            cout << "{\"status\": \"success\", \"message\": \"All properties for entity '" << name << "' have been cleared.\"}" << endl;
-            return;
+            return false;
         }
 
-        // Iterate through each key and delete if it exists
-        bool anyKeyFound = false;
-        for (const string &key : keys)
+        auto &values = index[key];
+        for (Node *node : nodeTable)
         {
-            if (node->properties.find(key) != node->properties.end())
+            if (!node)
             {
-                // Delete the specific property if it exists
-                node->deleteProperty(key);
-                anyKeyFound = true;
+                continue; // Free slot
             }
-            else
+            auto it = node->properties.find(key);
+            if (it != node->properties.end())
             {
-                cout << "{\"warning\": \"Property '" << key << "' not found for entity '" << name << "'.\"}" << endl;
+                values[it->second.text].insert(node);
             }
         }
-
-        // If none of the specified keys were found, notify the user
-        if (!anyKeyFound)
-        {
-            cout << "{\"error\": \"None of the specified properties were found for entity '" << name << "'.\"}" << endl;
-        }
-        else
-        {
-            cout << "{\"status\": \"success\", \"message\": \"Specified properties for entity '" << name << "' have been deleted where found.\"}" << endl;
-        }
+        return true;
     }
 
-    void getNodesByLabel(const string &label)
+    // Starts keeping a property key's values sorted and fills it from the given nodes.
+    // Returns false if the key already has a range index.
+    bool createRangeIndex(Symbol key, const vector<Node *> &nodeTable)
     {
-        // Check if the label exists in the index
-        auto it = labelIndex.find(label);
-        if (it != labelIndex.end())
+        if (hasRange(key))
         {
-            // Start JSON object
-            cout << "{" << endl;
-            cout << "  \"label\": \"" << label << "\"," << endl;
-            cout << "  \"entities\": [" << endl;
-
-            int count = 0;
-            int totalNodes = it->second.size();
+            return false;
+        }
 
-            for (auto node : it->second)
+        // Sort once and append in order, so every insert lands at the end of the tree
+        vector<pair<const PropertyValue *, Node *>> entries;
+        for (Node *node : nodeTable)
+        {
+            if (!node)
             {
-                // Print each node's name
-                cout << "    \"" << node->name << "\"";
-
-                // Add a comma if this is not the last node
-                if (++count < totalNodes)
-                {
-                    cout << ",";
-                }
-                cout << endl;
+                continue; // Free slot
+            }
+            auto it = node->properties.find(key);
+            if (it != node->properties.end())
+            {
+                entries.emplace_back(&it->second, node);
             }
-
-            cout << "  ]" << endl; // Close the entities array
-            cout << "}" << endl;   // Close the JSON object
         }
-        else
+        sort(entries.begin(), entries.end(), RangeEntryLess());
+
+        RangeIndex &range = ranges[key];
+        for (const auto &entry : entries)
         {
-            cout << "Error: Label \"" << label << "\" does not exist." << endl;
+            range.emplace_hint(range.end(), entry);
         }
+        return true;
     }
 
-    void addRelationship(const string &nodeName1, const string &nodeName2, const string &relationshipType)
+    // Records that a node now holds `value` for `key` (ignored for keys without an index).
+    // `value` must be the one stored in the node's property map.
+    void add(Node *node, Symbol key, const PropertyValue &value)
     {
-        // Check if both nodes exist in the graph
-        if (nodes.find(nodeName1) == nodes.end() || nodes.find(nodeName2) == nodes.end())
-        {
-            cout << "{\"error\": \"One or both nodes not found in the graph.\"}" << endl;
-            return; // Exit the function if either node does not exist
-        }
-
-        // Create a pair to represent the relationship
-        pair<string, Relationship *> relationshipPair = {nodeName2, new Relationship(relationshipType)};
-
-        // Check if the relationship already exists
-        auto &fromSet = relationships[nodeName1]; // Get the set of relationships for nodeName1
-        auto it = fromSet.find(relationshipPair);
-
-        if (it != fromSet.end())
+        auto keyIt = index.find(key);
+        if (keyIt != index.end())
         {
-            // Update the existing relationship type
-            it->second->relation = relationshipType; // Update the relationship type
-            cout << "{\"status\": \"success\", \"message\": \"Updated relationship between \"" << nodeName1 << "\" and \"" << nodeName2 << "\" to \"" << relationshipType << "\"." << endl;
+            keyIt->second[value.text].insert(node);
         }
-        else
+        auto rangeIt = ranges.find(key);
+        if (rangeIt != ranges.end())
         {
-            // Add the new relationship to the set
-            fromSet.insert(relationshipPair);
-            cout << "{\"status\": \"success\", \"message\": \"Added relationship between \"" << nodeName1 << "\" and \"" << nodeName2 << "\" as \"" << relationshipType << "\"." << endl;
+            rangeIt->second.emplace(&value, node);
         }
     }
 
-    void addRelationshipProperty(const string &name1, const string &name2, const string &key, const string &value)
+    // Forgets that a node holds `value` for `key`, dropping empty value buckets
+    void remove(Node *node, Symbol key, const PropertyValue &value)
     {
-        // Check if there are relationships for name1
-        if (relationships.find(name1) == relationships.end())
+        auto rangeIt = ranges.find(key);
+        if (rangeIt != ranges.end())
         {
-            cout << "{\"error\": \"No relationships found for node \"" << name1 << "\".\"}" << endl;
-            return;
+            rangeIt->second.erase({&value, node});
         }
 
-        // Get the set of relationships for name1
-        auto &fromSet = relationships[name1];
-
-        // Find the relationship to name2
-        auto it = std::find_if(fromSet.begin(), fromSet.end(), [&](const auto &relationshipPair)
-                               {
-                                   return relationshipPair.first == name2; // Match the second node
-                               });
-
-        // Check if the relationship exists
-        if (it == fromSet.end())
+        auto keyIt = index.find(key);
+        if (keyIt == index.end())
         {
-            cout << "{\"error\": \"No relationship exists between \"" << name1 << "\" and \"" << name2 << "\".\"}" << endl;
             return;
         }
 
-        // Retrieve the existing relationship object
-        Relationship *relationship = it->second; // Get the Relationship* from the found pair
-        if (!relationship)
+        auto valueIt = keyIt->second.find(value.text);
+        if (valueIt != keyIt->second.end())
         {
-            cout << "{\"error\": \"Relationship object is null.\"}" << endl;
-            return;
+            valueIt->second.erase(node);
+            if (valueIt->second.empty())
+            {
+                keyIt->second.erase(valueIt);
+            }
         }
-
-        // Set or update the specified property of the relationship
-        relationship->setProperty(key, value);
+    }
+
+    // Removes every property of a node from the index, used before clearing or deleting it
+    void removeAll(Node *node)
+    {
+        for (const auto &property : node->properties)
+        {
+            remove(node, property.first, property.second);
+        }
+    }
+
+    // Returns the nodes holding `value` for an indexed `key`, or nullptr if there are none
+    const unordered_set<Node *> *find(Symbol key, const string &value) const
+    {
+        auto keyIt = index.find(key);
+        if (keyIt == index.end())
+        {
+            return nullptr;
+        }
+
+        auto valueIt = keyIt->second.find(value);
+        return valueIt != keyIt->second.end() ? &valueIt->second : nullptr;
+    }
+
+    // Calls visit(node, value) in value order for every node whose value of a range indexed `key`
+    // lies between `lower` and `upper` (either may be null for no bound) and is of the same kind
+    // as the bounds: a numeric range never returns text values and vice versa
+    template <typename Visit>
+    void scanRange(Symbol key, const PropertyValue *lower, bool lowerInclusive,
+                   const PropertyValue *upper, bool upperInclusive, Visit visit) const
+    {
+        auto rangeIt = ranges.find(key);
+        if (rangeIt == ranges.end() || (!lower && !upper))
+        {
+            return;
+        }
+        const RangeIndex &range = rangeIt->second;
+        int kind = (lower ? lower : upper)->kind();
+
+        // Without a lower bound, start at the smallest value of the bounds' kind
+        PropertyValue smallest = PropertyValue::lowest(kind);
+        if (!lower)
+        {
+            lower = &smallest;
+            lowerInclusive = true;
+        }
+
+        for (auto it = range.lower_bound({lower, nullptr}); it != range.end(); ++it)
+        {
+            const PropertyValue &value = *it->first;
+            if (value.kind() != kind)
+            {
+                break;
+            }
+            if (!lowerInclusive && compareValues(value, *lower) == 0)
+            {
+                continue;
+            }
+            if (upper)
+            {
+                int order = compareValues(value, *upper);
+                if (order > 0 || (order == 0 && !upperInclusive))
+                {
+                    break;
+                }
+            }
+            visit(it->second, value);
+        }
+    }
+};
+
+// Columnar copy of numeric property values for the entities of one label (CREATE_COLUMNS).
+// Row r stands for rows[r]. Each column holds its key's value for every row as a double, next to
+// a bitmap telling which rows have a numeric value for the key at all, so a scan over a label
+// reads flat arrays instead of visiting every entity's property map. Integers a double cannot
+// hold exactly are flagged in a second bitmap instead and read from the entity. Rows stay dense: removing
+// an entity moves the last row into its place.
+class LabelTable
+{
+public:
+    struct Column
+    {
+        vector<double> values;
+        vector<uint64_t> present; // Bit r set: values[r] is row r's value
+        vector<uint64_t> inexact; // Bit r set: row r holds a number a double cannot (read the entity)
+    };
+
+    // Returns true if a column holds the value exactly; integers beyond 2^53 would be rounded
+    static bool holds(const PropertyValue &value)
+    {
+        const int64_t Exact = int64_t(1) << 53;
+        return value.type == ValueType::Real || (value.type == ValueType::Integer && value.integer >= -Exact && value.integer <= Exact);
+    }
+
+    vector<Node *> rows;
+    unordered_map<Symbol, Column> columns;
+
+    void addRow(Node *node)
+    {
+        node->labelSlot = rows.size();
+        rows.push_back(node);
+        for (auto &column : columns)
+        {
+            column.second.values.push_back(0);
+            column.second.present.resize((rows.size() + 63) / 64);
+            column.second.inexact.resize((rows.size() + 63) / 64);
+        }
+    }
+
+    void removeRow(Node *node)
+    {
+        uint32_t slot = node->labelSlot;
+        uint32_t last = rows.size() - 1;
+        for (auto &column : columns)
+        {
+            Column &c = column.second;
+            c.values[slot] = c.values[last];
+            setBit(c.present, slot, testBit(c.present, last));
+            setBit(c.inexact, slot, testBit(c.inexact, last));
+            c.values.pop_back();
+            setBit(c.present, last, false);
+            setBit(c.inexact, last, false);
+            c.present.resize((rows.size() + 62) / 64);
+            c.inexact.resize((rows.size() + 62) / 64);
+        }
+        rows[slot] = rows[last];
+        rows[slot]->labelSlot = slot;
+        rows.pop_back();
+        node->labelSlot = UINT32_MAX;
+    }
+
+    // Stores a node's value for `key`, if the key has a column (non-numeric values count as absent,
+    // numbers the column cannot hold exactly as inexact)
+    void set(Node *node, Symbol key, const PropertyValue &value)
+    {
+        auto it = columns.find(key);
+        if (it != columns.end())
+        {
+            it->second.values[node->labelSlot] = holds(value) ? value.number() : 0;
+            setBit(it->second.present, node->labelSlot, holds(value));
+            setBit(it->second.inexact, node->labelSlot, value.isNumber() && !holds(value));
+        }
+    }
+
+    void clear(Node *node, Symbol key)
+    {
+        auto it = columns.find(key);
+        if (it != columns.end())
+        {
+            setBit(it->second.present, node->labelSlot, false);
+            setBit(it->second.inexact, node->labelSlot, false);
+        }
+    }
+
+    void clearRow(Node *node)
+    {
+        for (auto &column : columns)
+        {
+            setBit(column.second.present, node->labelSlot, false);
+            setBit(column.second.inexact, node->labelSlot, false);
+        }
+    }
+
+    // Adds a column for `key` filled from the rows. Returns false if it already exists.
+    bool addColumn(Symbol key)
+    {
+        if (columns.find(key) != columns.end())
+        {
+            return false;
+        }
+        Column &column = columns[key];
+        column.values.assign(rows.size(), 0);
+        column.present.assign((rows.size() + 63) / 64, 0);
+        column.inexact.assign((rows.size() + 63) / 64, 0);
+        for (size_t r = 0; r < rows.size(); ++r)
+        {
+            auto it = rows[r]->properties.find(key);
+            if (it != rows[r]->properties.end() && holds(it->second))
+            {
+                column.values[r] = it->second.number();
+                column.present[r / 64] |= uint64_t(1) << (r % 64);
+            }
+            else if (it != rows[r]->properties.end() && it->second.isNumber())
+            {
+                column.inexact[r / 64] |= uint64_t(1) << (r % 64);
+            }
+        }
+        return true;
+    }
+
+    // Narrows `selected` (a bitmap over the rows) to the rows whose value in `column` lies in
+    // [lower, upper], keeping inexact rows for the caller to check. The comparison runs over 64
+    // rows at a time without branches, so the compiler can keep it in vector registers; words
+    // with no candidate left are skipped.
+    static void filter(const Column &column, double lower, double upper, vector<uint64_t> &selected)
+    {
+        size_t rowCount = column.values.size();
+        const double *values = column.values.data();
+        for (size_t word = 0; word < selected.size(); ++word)
+        {
+            uint64_t candidates = selected[word] & column.present[word];
+            uint64_t unknown = selected[word] & column.inexact[word];
+            if (!candidates)
+            {
+                selected[word] = unknown;
+                continue;
+            }
+            size_t base = word * 64;
+            size_t count = min<size_t>(64, rowCount - base);
+            uint64_t inRange = 0;
+            for (size_t j = 0; j < count; ++j)
+            {
+                double value = values[base + j];
+                inRange |= uint64_t((value >= lower) & (value <= upper)) << j;
+            }
+            selected[word] = (candidates & inRange) | unknown;
+        }
+    }
+
+private:
+    static bool testBit(const vector<uint64_t> &bits, size_t i)
+    {
+        return (bits[i / 64] >> (i % 64)) & 1;
+    }
+
+    static void setBit(vector<uint64_t> &bits, size_t i, bool value)
+    {
+        uint64_t mask = uint64_t(1) << (i % 64);
+        bits[i / 64] = value ? bits[i / 64] | mask : bits[i / 64] & ~mask;
+    }
+};
+
+// Removes leading and trailing whitespace from a view without copying
+inline string_view trimView(string_view text)
+{
+    size_t first = text.find_first_not_of(" \t\n\r");
+    if (first == string_view::npos)
+    {
+        return string_view();
+    }
+    size_t last = text.find_last_not_of(" \t\n\r");
+    return text.substr(first, last - first + 1);
+}
+
+// A query split into its command keyword and the trimmed, comma separated arguments between
+// the braces. Every field points into the original query text, so parsing allocates nothing.
+struct ParsedQuery
+{
+    static const size_t MaxArgs = 256;
+
+    string_view command;
+    string_view args[MaxArgs];
+    size_t argCount = 0;
+};
+
+enum class ParseStatus
+{
+    Ok,
+    MissingOpenBrace,
+    MissingCloseBrace,
+    TooManyArgs
+};
+
+// Tokenizes `COMMAND{arg1,arg2,...}` in a single pass over the text.
+// An empty body ("MEMORY_STATS{}") yields no arguments; text after the closing brace is ignored.
+inline ParseStatus parseQuery(string_view query, ParsedQuery &parsed)
+{
+    parsed.argCount = 0;
+
+    size_t openBrace = query.find('{');
+    if (openBrace == string_view::npos)
+    {
+        parsed.command = trimView(query);
+        return ParseStatus::MissingOpenBrace;
+    }
+    parsed.command = trimView(query.substr(0, openBrace));
+
+    size_t argStart = openBrace + 1;
+    for (size_t i = argStart; i < query.size(); ++i)
+    {
+        char c = query[i];
+        if (c != ',' && c != '}')
+        {
+            continue;
+        }
+
+        string_view arg = trimView(query.substr(argStart, i - argStart));
+        if (c == '}' && parsed.argCount == 0 && arg.empty())
+        {
+            return ParseStatus::Ok; // Empty body
+        }
+        if (parsed.argCount == ParsedQuery::MaxArgs)
+        {
+            return ParseStatus::TooManyArgs;
+        }
+        parsed.args[parsed.argCount++] = arg;
+
+        if (c == '}')
+        {
+            return ParseStatus::Ok;
+        }
+        argStart = i + 1;
+    }
+    return ParseStatus::MissingCloseBrace;
+}
+
+// Splits a `key:value` argument at its first colon, trimming both sides.
+// Returns false if the argument has no colon.
+inline bool splitKeyValue(string_view argument, string_view &key, string_view &value)
+{
+    size_t colonPos = argument.find(':');
+    if (colonPos == string_view::npos)
+    {
+        return false;
+    }
+    key = trimView(argument.substr(0, colonPos));
+    value = trimView(argument.substr(colonPos + 1));
+    return true;
+}
+
+// One condition of a GET query: "Key:value" (same text), "Key<v", "Key<=v", "Key>v", "Key>=v" or
+// "Key BETWEEN a b" (both ends included). Comparisons are typed: a number only compares with
+// numbers, text with text.
+struct PropertyPredicate
+{
+    string text; // Normalized form, for the response
+    string key;
+    bool equality = false;
+    PropertyValue lower, upper; // For equality, `lower` holds the value
+    bool hasLower = false, hasUpper = false;
+    bool lowerInclusive = true, upperInclusive = true;
+
+    bool matches(const PropertyValue &value) const
+    {
+        if (equality)
+        {
+            return value.text == lower.text;
+        }
+        if (hasLower)
+        {
+            int order = compareValues(value, lower);
+            if (value.kind() != lower.kind() || order < 0 || (order == 0 && !lowerInclusive))
+            {
+                return false;
+            }
+        }
+        if (hasUpper)
+        {
+            int order = compareValues(value, upper);
+            if (value.kind() != upper.kind() || order > 0 || (order == 0 && !upperInclusive))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Parses one GET argument into a predicate. Returns false if it has no operator;
+// an empty key or value leaves predicate.key or predicate.text empty.
+inline bool parsePredicate(string_view argument, PropertyPredicate &predicate)
+{
+    size_t between = argument.find(" BETWEEN ");
+    if (between != string_view::npos)
+    {
+        // "Key BETWEEN a b" or "Key BETWEEN a AND b"
+        predicate.key = string(trimView(argument.substr(0, between)));
+        string_view bounds = trimView(argument.substr(between + 9));
+        size_t gap = bounds.find_first_of(" \t");
+        string_view low = bounds.substr(0, gap);
+        string_view high = gap == string_view::npos ? string_view() : trimView(bounds.substr(gap));
+        if (high.substr(0, 4) == "AND " || high.substr(0, 4) == "AND\t")
+        {
+            high = trimView(high.substr(4));
+        }
+        if (low.empty() || high.empty())
+        {
+            return true;
+        }
+        predicate.lower.assign(string(low));
+        predicate.upper.assign(string(high));
+        predicate.hasLower = predicate.hasUpper = true;
+        predicate.text = predicate.key + " BETWEEN " + string(low) + " " + string(high);
+        return true;
+    }
+
+    size_t operatorPos = argument.find_first_of(":=<>");
+    if (operatorPos == string_view::npos)
+    {
+        return false;
+    }
+    char op = argument[operatorPos];
+    bool inclusive = op != ':' && op != '=' && operatorPos + 1 < argument.size() && argument[operatorPos + 1] == '=';
+    predicate.key = string(trimView(argument.substr(0, operatorPos)));
+    string_view value = trimView(argument.substr(operatorPos + 1 + inclusive));
+    if (value.empty())
+    {
+        return true;
+    }
+
+    if (op == ':' || op == '=')
+    {
+        predicate.equality = true;
+        predicate.lower.assign(string(value));
+        predicate.text = predicate.key + ":" + string(value);
+    }
+    else
+    {
+        PropertyValue &bound = op == '>' ? predicate.lower : predicate.upper;
+        bound.assign(string(value));
+        (op == '>' ? predicate.hasLower : predicate.hasUpper) = true;
+        (op == '>' ? predicate.lowerInclusive : predicate.upperInclusive) = inclusive;
+        predicate.text = predicate.key + op + (inclusive ? "=" : "") + string(value);
+    }
+    return true;
+}
+
+// Aggregate functions of AGG{...}
+enum class AggregateFunction : uint8_t
+{
+    Count,
+    Sum,
+    Average,
+    Minimum,
+    Maximum
+};
+
+// One output column of AGG: FUNCTION(Key), or COUNT(*) for the number of entities
+struct AggregateSpec
+{
+    string text; // Normalized form, e.g. "AVG(Age)", for the response
+    AggregateFunction function = AggregateFunction::Count;
+    string key; // Empty for COUNT(*)
+};
+
+// Stores a + b in `sum` and returns false, or returns true if the sum does not fit in int64
+inline bool addOverflows(int64_t a, int64_t b, int64_t &sum)
+{
+#ifdef _MSC_VER
+    if ((b > 0 && a > numeric_limits<int64_t>::max() - b) || (b < 0 && a < numeric_limits<int64_t>::min() - b))
+    {
+        return true;
+    }
+    sum = a + b;
+    return false;
+#else
+    return __builtin_add_overflow(a, b, &sum);
+#endif
+}
+
+// Running state of one aggregate over some entities. COUNT counts the entities that have the
+// key at all; the other functions only see values that are numbers. Whole numbers are also
+// accumulated in int64, which is what SUM, MIN and MAX report until a fractional value shows up
+// (or, for SUM, the total no longer fits); a double would round integers beyond 2^53.
+struct AggregateState
+{
+    size_t count = 0;
+    double sum = 0;
+    double lowest = numeric_limits<double>::infinity();
+    double highest = -numeric_limits<double>::infinity();
+    bool whole = true;    // Every value was a whole number: integerLowest/integerHighest are exact
+    bool exactSum = true; // ... and their total fits in integerSum
+    int64_t integerSum = 0;
+    int64_t integerLowest = numeric_limits<int64_t>::max();
+    int64_t integerHighest = numeric_limits<int64_t>::min();
+
+    void add(int64_t value)
+    {
+        ++count;
+        sum += value;
+        lowest = min<double>(lowest, value);
+        highest = max<double>(highest, value);
+        exactSum = exactSum && !addOverflows(integerSum, value, integerSum);
+        integerLowest = min(integerLowest, value);
+        integerHighest = max(integerHighest, value);
+    }
+
+    void add(double value)
+    {
+        if (fabs(value) <= Exact && value == floor(value))
+        {
+            add(static_cast<int64_t>(value));
+            return;
+        }
+        ++count;
+        sum += value;
+        lowest = min(lowest, value);
+        highest = max(highest, value);
+        whole = exactSum = false;
+    }
+
+    void add(const PropertyValue &value)
+    {
+        if (value.type == ValueType::Integer)
+        {
+            add(value.integer);
+        }
+        else
+        {
+            add(value.number());
+        }
+    }
+
+    void merge(const AggregateState &other)
+    {
+        count += other.count;
+        sum += other.sum;
+        lowest = min(lowest, other.lowest);
+        highest = max(highest, other.highest);
+        whole = whole && other.whole;
+        exactSum = exactSum && other.exactSum && !addOverflows(integerSum, other.integerSum, integerSum);
+        integerLowest = min(integerLowest, other.integerLowest);
+        integerHighest = max(integerHighest, other.integerHighest);
+    }
+
+    // Largest magnitude up to which every integer is a double
+    static constexpr double Exact = 9007199254740992.0;
+};
+
+// Splits "NAME(inner)" into its trimmed parts. Returns false unless the argument has that shape
+// and something between the parentheses.
+inline bool splitCall(string_view argument, string_view &name, string_view &inner)
+{
+    size_t open = argument.find('(');
+    if (open == string_view::npos || argument.back() != ')')
+    {
+        return false;
+    }
+    name = trimView(argument.substr(0, open));
+    inner = trimView(argument.substr(open + 1, argument.size() - open - 2));
+    return !name.empty() && !inner.empty();
+}
+
+// Parses "COUNT(Key)", "COUNT(*)", "SUM(Key)", "AVG(Key)", "MIN(Key)" or "MAX(Key)"
+inline bool parseAggregate(string_view argument, AggregateSpec &spec)
+{
+    static const unordered_map<string_view, AggregateFunction> functions = {
+        {"COUNT", AggregateFunction::Count},
+        {"SUM", AggregateFunction::Sum},
+        {"AVG", AggregateFunction::Average},
+        {"MIN", AggregateFunction::Minimum},
+        {"MAX", AggregateFunction::Maximum},
+    };
+    string_view name, inner;
+    if (!splitCall(argument, name, inner))
+    {
+        return false;
+    }
+    auto it = functions.find(name);
+    if (it == functions.end() || (inner == "*" && it->second != AggregateFunction::Count))
+    {
+        return false;
+    }
+    spec.function = it->second;
+    spec.key = inner == "*" ? string() : string(inner);
+    spec.text = string(name) + "(" + string(inner) + ")";
+    return true;
+}
+
+// Argument of COUNT{...}: "Label", or "Source-[Relation1|Relation2]->Target" or
+// "Source<-[Relation]-Target", where a label may be * for any label and the types may be left
+// out (or ALL) for any type
+struct CountPattern
+{
+    string source, target;
+    vector<string> relations;
+    bool hasRelationship = false;
+    bool outgoing = true;
+};
+
+inline bool parseCountPattern(string_view text, CountPattern &pattern)
+{
+    size_t open = text.find('[');
+    if (open == string_view::npos)
+    {
+        pattern.source = string(trimView(text));
+        return !pattern.source.empty() && pattern.source.find_first_of("-<>]") == string::npos;
+    }
+
+    size_t close = text.find(']', open);
+    string_view left = trimView(text.substr(0, open));
+    if (close == string_view::npos || left.empty() || left.back() != '-')
+    {
+        return false;
+    }
+    left.remove_suffix(1);
+    pattern.outgoing = left.empty() || left.back() != '<';
+    if (!pattern.outgoing)
+    {
+        left.remove_suffix(1);
+    }
+    string_view right = trimView(text.substr(close + 1));
+    string_view arrow = pattern.outgoing ? "->" : "-";
+    if (right.substr(0, arrow.size()) != arrow)
+    {
+        return false;
+    }
+    right.remove_prefix(arrow.size());
+
+    string_view relations = trimView(text.substr(open + 1, close - open - 1));
+    while (!relations.empty() && relations != "ALL")
+    {
+        size_t bar = relations.find('|');
+        string_view relation = trimView(relations.substr(0, bar));
+        if (relation.empty())
+        {
+            return false;
+        }
+        pattern.relations.emplace_back(relation);
+        relations = bar == string_view::npos ? string_view() : relations.substr(bar + 1);
+    }
+    pattern.hasRelationship = true;
+    pattern.source = string(trimView(left));
+    pattern.target = string(trimView(right));
+    return !pattern.source.empty() && !pattern.target.empty() && pattern.target.find_first_of("-<>[]") == string::npos;
+}
+
+// Returns true (after reporting it as a JSON or plain error) if any argument of the query is empty
+inline bool reportEmptyArgs(const ParsedQuery &query, bool jsonError)
+{
+    for (size_t i = 0; i < query.argCount; ++i)
+    {
+        if (query.args[i].empty())
+        {
+            if (jsonError)
+            {
+                out << "{\"error\": \"Malformed " << query.command << " query - empty fields found.\"}" << endl;
+            }
+            else
+            {
+                out << "Error: Malformed " << query.command << " query - empty fields found." << endl;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses a whole, non-negative number argument such as a depth or a limit.
+// Returns false unless the whole text is digits.
+inline bool parseCount(string_view text, size_t &value)
+{
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return !text.empty() && result.ec == errc() && result.ptr == text.data() + text.size();
+}
+
+// Parses a property value such as "12.5" as a number, accepting exactly the texts PropertyValue
+// types as numbers: one finite number in from_chars syntax (no hex, spaces or "inf"), read the
+// same way in every locale. Returns false unless the whole text is one.
+inline bool parseNumber(string_view text, double &value)
+{
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return !text.empty() && result.ec == errc() && result.ptr == text.data() + text.size() && std::isfinite(value);
+}
+
+// One node of a MATCH pattern: "(variable:Label,Key:value,...)". Every part is optional.
+struct MatchNodePattern
+{
+    string_view variable, label;
+    vector<pair<string_view, string_view>> filters;
+};
+
+// One relationship of a MATCH pattern between the nodes left and right of it: "-[A|B]->" points
+// right, "<-[A|B]-" points left. No types (or "ALL") matches any type.
+struct MatchEdgePattern
+{
+    vector<string_view> relations;
+    bool pointsRight;
+};
+
+// A chain of n nodes joined by n - 1 relationships, optionally followed by ",LIMIT:n"
+struct MatchPattern
+{
+    vector<MatchNodePattern> nodes;
+    vector<MatchEdgePattern> edges;
+    size_t limit = SIZE_MAX;
+};
+
+// Parses the body of a MATCH query. Returns false if it is malformed, with `errorAt` set to the
+// offset of the first character that does not fit.
+inline bool parseMatchPattern(string_view text, MatchPattern &pattern, size_t &errorAt)
+{
+    size_t pos = 0;
+    auto skipSpaces = [&]()
+    {
+        while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos])))
+        {
+            ++pos;
+        }
+    };
+    auto consume = [&](string_view token)
+    {
+        skipSpaces();
+        if (text.substr(pos, token.size()) != token)
+        {
+            return false;
+        }
+        pos += token.size();
+        return true;
+    };
+    // Reads up to (not including) the first of `stops`, trimmed
+    auto readUntil = [&](string_view stops)
+    {
+        size_t end = text.find_first_of(stops, pos);
+        end = end == string_view::npos ? text.size() : end;
+        string_view token = trimView(text.substr(pos, end - pos));
+        pos = end;
+        return token;
+    };
+
+    while (true)
+    {
+        // Node: "(" [variable] [":" Label] {"," Key ":" value} ")"
+        if (!consume("("))
+        {
+            errorAt = pos;
+            return false;
+        }
+        MatchNodePattern node;
+        node.variable = readUntil(":,)([");
+        if (pos < text.size() && text[pos] == ':')
+        {
+            ++pos;
+            node.label = readUntil(",)([");
+        }
+        while (pos < text.size() && text[pos] == ',')
+        {
+            ++pos;
+            string_view key, value;
+            if (!splitKeyValue(readUntil(",)"), key, value) || key.empty())
+            {
+                errorAt = pos;
+                return false;
+            }
+            node.filters.emplace_back(key, value);
+        }
+        if (!consume(")"))
+        {
+            errorAt = pos;
+            return false;
+        }
+        pattern.nodes.push_back(node);
+
+        // Relationship to the next node, or the end of the chain
+        MatchEdgePattern edge;
+        if (consume("-["))
+        {
+            edge.pointsRight = true;
+        }
+        else if (consume("<-["))
+        {
+            edge.pointsRight = false;
+        }
+        else
+        {
+            break;
+        }
+        string_view types = readUntil("]");
+        while (!types.empty())
+        {
+            size_t bar = types.find('|');
+            string_view type = trimView(types.substr(0, bar));
+            if (type != "ALL")
+            {
+                edge.relations.push_back(type);
+            }
+            types = bar == string_view::npos ? string_view() : types.substr(bar + 1);
+        }
+        if (!consume(edge.pointsRight ? "]->" : "]-"))
+        {
+            errorAt = pos;
+            return false;
+        }
+        pattern.edges.push_back(edge);
+    }
+
+    // Optional row limit
+    if (consume(","))
+    {
+        string_view key, value;
+        size_t limitAt = pos;
+        if (!splitKeyValue(readUntil(""), key, value) || key != "LIMIT" || !parseCount(value, pattern.limit))
+        {
+            errorAt = limitAt;
+            return false;
+        }
+    }
+    skipSpaces();
+    if (pos != text.size())
+    {
+        errorAt = pos;
+        return false;
+    }
+    return true;
+}
+
+// One step of a MATCH plan: binds node `to` by following pattern relationship `edge` from the
+// already bound node `from`
+struct MatchStep
+{
+    size_t edge, from, to;
+    bool outgoing; // Follow from's outgoing (or else incoming) relationships
+    double rows;   // Expected partial matches after this step
+};
+
+// Execution order chosen for a MATCH pattern, with the graph version and size it was chosen at
+struct MatchPlan
+{
+    size_t start;
+    double startRows;
+    vector<MatchStep> steps;
+    uint64_t version;
+    size_t graphSize;
+};
+
+// Removes the spaces the parser would ignore anyway (around braces and commas, and for MATCH
+// also around parentheses, brackets and type separators), so queries differing only in layout
+// share one plan cache entry
+inline string normalizeQuery(string_view query)
+{
+    query = trimView(query);
+    string_view structural = query.substr(0, query.find('{')) == "MATCH" ? "{},()[]|" : "{},";
+
+    string normalized;
+    normalized.reserve(query.size());
+    for (size_t i = 0; i < query.size(); ++i)
+    {
+        if (!isspace(static_cast<unsigned char>(query[i])))
+        {
+            normalized += query[i];
+            continue;
+        }
+        size_t next = i;
+        while (next < query.size() && isspace(static_cast<unsigned char>(query[next])))
+        {
+            ++next;
+        }
+        bool besideStructural = (!normalized.empty() && structural.find(normalized.back()) != string_view::npos) ||
+                                structural.find(query[next]) != string_view::npos;
+        if (!besideStructural)
+        {
+            normalized.append(query.substr(i, next - i));
+        }
+        i = next - 1;
+    }
+    return normalized;
+}
+
+// Returns the highest n of the "$n" placeholders in a prepared query (0 if there are none)
+inline size_t highestParameter(string_view text)
+{
+    size_t highest = 0;
+    for (size_t i = text.find('$'); i != string_view::npos; i = text.find('$', i + 1))
+    {
+        size_t n = 0;
+        auto result = from_chars(text.data() + i + 1, text.data() + text.size(), n);
+        if (result.ec == errc() && n > highest)
+        {
+            highest = n;
+        }
+    }
+    return highest;
+}
+
+// Copies `text` into `result` with every "$n" replaced by the n-th parameter (counted from 1)
+inline void substituteParameters(string_view text, const vector<string_view> &parameters, string &result)
+{
+    result.clear();
+    size_t copied = 0;
+    for (size_t i = text.find('$'); i != string_view::npos; i = text.find('$', i + 1))
+    {
+        size_t n = 0;
+        auto parsed = from_chars(text.data() + i + 1, text.data() + text.size(), n);
+        if (parsed.ec != errc() || n == 0 || n > parameters.size())
+        {
+            continue;
+        }
+        result.append(text.substr(copied, i - copied));
+        result.append(parameters[n - 1]);
+        copied = parsed.ptr - text.data();
+        i = copied - 1;
+    }
+    result.append(text.substr(copied));
+}
+
+// Counts the lines of a file by scanning it in large blocks, so BULK_LOAD can size its tables
+// before inserting anything. Returns 0 if the file cannot be opened.
+inline size_t countLines(const string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return 0;
+    }
+
+    vector<char> block(1 << 20);
+    size_t lines = 0, read;
+    while ((read = fread(block.data(), 1, block.size(), file)) > 0)
+    {
+        lines += count(block.begin(), block.begin() + read, '\n');
+    }
+    fclose(file);
+    return lines;
+}
+
+// Splits one CSV row into `fields`, reusing their storage from the previous row. Fields may be
+// wrapped in double quotes, with "" standing for a quote inside them; rows cannot span lines.
+inline void splitCsvRow(const string &line, vector<string> &fields)
+{
+    size_t count = 0;
+    size_t pos = 0, end = line.size();
+    if (end > 0 && line[end - 1] == '\r')
+    {
+        --end; // Tolerate CRLF line endings
+    }
+
+    while (true)
+    {
+        if (count == fields.size())
+        {
+            fields.emplace_back();
+        }
+        string &field = fields[count++];
+        field.clear();
+
+        if (pos < end && line[pos] == '"')
+        {
+            // Quoted field: copy up to the closing quote, unescaping ""
+            for (++pos; pos < end; ++pos)
+            {
+                if (line[pos] == '"')
+                {
+                    if (pos + 1 < end && line[pos + 1] == '"')
+                    {
+                        field += '"';
+                        ++pos;
+                    }
+                    else
+                    {
+                        ++pos;
+                        break;
+                    }
+                }
+                else
+                {
+                    field += line[pos];
+                }
+            }
+            pos = min(line.find(',', pos), end);
+        }
+        else
+        {
+            size_t comma = min(line.find(',', pos), end);
+            field.append(line, pos, comma - pos);
+            pos = comma;
+        }
+
+        if (pos >= end)
+        {
+            break;
+        }
+        ++pos; // Skip the comma
+    }
+    fields.resize(count);
+}
+
+// Forces data written to a file down to the disk. Returns false if any of it may not have made it.
+inline bool syncFile(FILE *file)
+{
+    if (fflush(file) != 0)
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Forces a directory entry change (a rename) down to the disk where the platform supports it.
+// Returns false if the directory cannot be synced.
+inline bool syncDirectory(const string &path)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#else
+    return true;
+#endif
+}
+
+// Set on a key in a snapshot's list of indexed keys when the index is a range index
+const uint32_t RangeIndexFlag = 0x80000000;
+
+// Fixed-width binary helpers for snapshots (host byte order)
+inline void writeU32(FILE *file, uint32_t value)
+{
+    fwrite(&value, sizeof(value), 1, file);
+}
+
+inline void writeU64(FILE *file, uint64_t value)
+{
+    fwrite(&value, sizeof(value), 1, file);
+}
+
+inline void writeString(FILE *file, const string &text)
+{
+    writeU32(file, text.size());
+    fwrite(text.data(), 1, text.size(), file);
+}
+
+inline bool readU32(FILE *file, uint32_t &value)
+{
+    return fread(&value, sizeof(value), 1, file) == 1;
+}
+
+inline bool readU64(FILE *file, uint64_t &value)
+{
+    return fread(&value, sizeof(value), 1, file) == 1;
+}
+
+inline bool readString(FILE *file, string &text)
+{
+    uint32_t size;
+    if (!readU32(file, size))
+    {
+        return false;
+    }
+    text.resize(size);
+    return fread(&text[0], 1, size, file) == size;
+}
+
+// Append-only log of mutating queries. Each record is one line, "<lsn> <query>", where the log
+// sequence number (lsn) increases by one per record. A snapshot remembers the last lsn it contains,
+// so recovery replays only the records after it.
+class WriteAheadLog
+{
+    FILE *file = nullptr;
+    uint64_t nextLsn = 1;
+    bool failed = false; // A write or sync failed: records may be missing until the log is reopened
+
+    // fsync after this many records (0 = never force, leave it to the OS)
+    size_t fsyncEvery = 1;
+    size_t unsynced = 0;
+
+public:
+    WriteAheadLog() = default;
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    ~WriteAheadLog()
+    {
+        close();
+    }
+
+    bool isOpen() const
+    {
+        return file != nullptr;
+    }
+
+    // Opens (or with `truncate`, restarts) the log; the next record gets lsn lastLsn + 1
+    bool open(const string &path, uint64_t lastLsn, bool truncate)
+    {
+        close();
+        file = fopen(path.c_str(), truncate ? "wb" : "ab");
+        nextLsn = lastLsn + 1;
+        unsynced = 0;
+        failed = false;
+        return file != nullptr;
+    }
+
+    void setFsyncEvery(size_t records)
+    {
+        fsyncEvery = records;
+    }
+
+    // Appends one query to the log, syncing it once enough records have accumulated. Returns false
+    // if the record may not have reached the log; from then on nothing is appended until the log
+    // is reopened, since it may end in a partial record.
+    bool append(string_view query)
+    {
+        if (!file || failed)
+        {
+            return false;
+        }
+        char lsn[24];
+        auto result = to_chars(lsn, lsn + sizeof(lsn), nextLsn++);
+        *result.ptr++ = ' ';
+        size_t lsnSize = result.ptr - lsn;
+        failed = fwrite(lsn, 1, lsnSize, file) != lsnSize || fwrite(query.data(), 1, query.size(), file) != query.size() ||
+                 fputc('\n', file) == EOF;
+
+        if (failed)
+        {
+            return false;
+        }
+        ++unsynced;
+        return fsyncEvery > 0 && unsynced >= fsyncEvery ? sync() : true;
+    }
+
+    // Makes every appended record durable (called before the responses acknowledging them go out).
+    // Returns false if a record that append accepted may not have reached the disk.
+    bool sync()
+    {
+        if (!file || unsynced == 0)
+        {
+            return true;
+        }
+        bool ok = fsyncEvery > 0 ? syncFile(file) : fflush(file) == 0;
+        failed = failed || !ok;
+        unsynced = 0;
+        return ok;
+    }
+
+    uint64_t lastLsn() const
+    {
+        return nextLsn - 1;
+    }
+
+    void close()
+    {
+        if (file)
+        {
+            sync();
+            fclose(file);
+            file = nullptr;
+        }
+    }
+};
+
+// Index of the lowest set bit of a non-zero word
+inline unsigned lowestBit(uint64_t word)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return index;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+// Asks the CPU to start loading `address` into cache ahead of its use
+inline void prefetch(const void *address)
+{
+#ifdef _MSC_VER
+    _mm_prefetch(static_cast<const char *>(address), _MM_HINT_T0);
+#else
+    __builtin_prefetch(address);
+#endif
+}
+
+// Calls onCommon(id) for every id found in both of two strictly increasing arrays, in increasing
+// order. If one array is far shorter (a hub's neighbours against a leaf's), each of its ids is
+// looked up in the other by binary search. Otherwise they are merged; with SSE2, a block of four
+// ids of `a` is compared against all four rotations of a block of `b` at once, then whichever
+// block ends with the smaller id moves on, and what is left is merged one id at a time.
+template <typename OnCommon>
+inline void intersectSorted(const NodeId *a, size_t aSize, const NodeId *b, size_t bSize, OnCommon onCommon)
+{
+    if (aSize * 32 < bSize || bSize * 32 < aSize)
+    {
+        bool aShorter = aSize < bSize;
+        const NodeId *shortList = aShorter ? a : b, *longList = aShorter ? b : a;
+        const NodeId *longEnd = longList + (aShorter ? bSize : aSize);
+        for (const NodeId *id = shortList; id != shortList + min(aSize, bSize); ++id)
+        {
+            longList = lower_bound(longList, longEnd, *id);
+            if (longList == longEnd)
+            {
+                return;
+            }
+            if (*longList == *id)
+            {
+                onCommon(*id);
+            }
+        }
+        return;
+    }
+
+    size_t i = 0, j = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    while (i + 4 <= aSize && j + 4 <= bSize)
+    {
+        __m128i blockA = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i blockB = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+        __m128i equal = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(blockA, blockB), _mm_cmpeq_epi32(blockA, _mm_shuffle_epi32(blockB, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(blockA, _mm_shuffle_epi32(blockB, _MM_SHUFFLE(1, 0, 3, 2))), _mm_cmpeq_epi32(blockA, _mm_shuffle_epi32(blockB, _MM_SHUFFLE(2, 1, 0, 3)))));
+        unsigned found = _mm_movemask_ps(_mm_castsi128_ps(equal)); // Bit k: a[i + k] is in the block of b
+        while (found)
+        {
+            onCommon(a[i + lowestBit(found)]);
+            found &= found - 1;
+        }
+        NodeId lastA = a[i + 3], lastB = b[j + 3];
+        i += lastA <= lastB ? 4 : 0;
+        j += lastB <= lastA ? 4 : 0;
+    }
+#endif
+    while (i < aSize && j < bSize)
+    {
+        if (a[i] == b[j])
+        {
+            onCommon(a[i]);
+            ++i;
+            ++j;
+        }
+        else if (a[i] < b[j])
+        {
+            ++i;
+        }
+        else
+        {
+            ++j;
+        }
+    }
+}
+
+// Bitmap over NodeIds marking the nodes a traversal has reached. Resetting clears only the words
+// that were written, so a short traversal on a large graph does not pay for the whole bitmap.
+class VisitedSet
+{
+    vector<uint64_t> words;
+    vector<uint32_t> dirty; // Indexes of the words that have bits set
+
+public:
+    // Empties the set and makes room for ids below `nodeCount`
+    void reset(size_t nodeCount)
+    {
+        for (uint32_t word : dirty)
+        {
+            words[word] = 0;
+        }
+        dirty.clear();
+        if (words.size() < (nodeCount + 63) / 64)
+        {
+            words.resize((nodeCount + 63) / 64, 0);
+        }
+    }
+
+    // Marks `id`; returns false if it was already marked
+    bool insert(NodeId id)
+    {
+        uint64_t &word = words[id >> 6];
+        uint64_t bit = uint64_t(1) << (id & 63);
+        if (word & bit)
+        {
+            return false;
+        }
+        if (word == 0)
+        {
+            dirty.push_back(id >> 6);
+        }
+        word |= bit;
+        return true;
+    }
+
+    bool contains(NodeId id) const
+    {
+        return words[id >> 6] & (uint64_t(1) << (id & 63));
+    }
+};
+
+// Fixed set of threads that run the iterations of parallel loops. Every participant (the pool's
+// threads plus the calling thread) starts with an equal share of the iterations and works through
+// it from the front; one that runs out steals the back half of another's remaining range. Uneven
+// iterations (a hub node's relationships, a slow query) therefore end up spread over all threads.
+class WorkerPool
+{
+    // Iterations a participant still owns, packed as (begin << 32) | end, so both the owner
+    // taking from the front and a thief splitting off the back change it with one CAS
+    struct alignas(64) WorkRange
+    {
+        atomic<uint64_t> bounds{0};
+    };
+
+    vector<thread> threads;
+    unique_ptr<WorkRange[]> ranges; // One per participant; the calling thread uses the last
+
+    // Held by the thread running a loop. A loop started while another is running (e.g. from a
+    // query that itself runs inside a parallel batch) simply runs inline on its thread.
+    mutex dispatch;
+
+    mutex lock;
+    condition_variable wake, finished;
+    const function<void(size_t)> *body = nullptr;
+    size_t generation = 0; // Bumped for every loop so sleeping threads notice new work
+    size_t running = 0;    // Pool threads still working on the current loop
+    bool stopping = false;
+
+    static uint64_t pack(uint64_t begin, uint64_t end)
+    {
+        return (begin << 32) | end;
+    }
+
+    // Takes the next iteration from the front of participant `self`'s own range
+    bool takeOwn(size_t self, size_t &iteration)
+    {
+        uint64_t bounds = ranges[self].bounds.load();
+        while (true)
+        {
+            uint64_t begin = bounds >> 32, end = bounds & 0xFFFFFFFF;
+            if (begin >= end)
+            {
+                return false;
+            }
+            if (ranges[self].bounds.compare_exchange_weak(bounds, pack(begin + 1, end)))
+            {
+                iteration = begin;
+                return true;
+            }
+        }
+    }
+
+    // Moves the back half of some other participant's range to `self`; false if all are empty
+    bool steal(size_t self)
+    {
+        size_t participants = threads.size() + 1;
+        for (size_t k = 1; k < participants; ++k)
+        {
+            WorkRange &victim = ranges[(self + k) % participants];
+            uint64_t bounds = victim.bounds.load();
+            while (true)
+            {
+                uint64_t begin = bounds >> 32, end = bounds & 0xFFFFFFFF;
+                if (begin >= end)
+                {
+                    break;
+                }
+                uint64_t middle = begin + (end - begin) / 2;
+                if (victim.bounds.compare_exchange_weak(bounds, pack(begin, middle)))
+                {
+                    ranges[self].bounds.store(pack(middle, end));
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void runIterations(size_t self)
+    {
+        size_t iteration;
+        do
+        {
+            while (takeOwn(self, iteration))
+            {
+                (*body)(iteration);
+            }
+        } while (steal(self));
+    }
+
+    void workerLoop(size_t self)
+    {
+        size_t seen = 0;
+        while (true)
+        {
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [&]
+                          { return stopping || generation != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+            }
+            runIterations(self);
+            {
+                lock_guard<mutex> guard(lock);
+                if (--running == 0)
+                {
+                    finished.notify_one();
+                }
+            }
+        }
+    }
+
+public:
+    explicit WorkerPool(size_t threadCount)
+        : ranges(new WorkRange[threadCount + 1])
+    {
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            threads.emplace_back(&WorkerPool::workerLoop, this, i);
+        }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread &worker : threads)
+        {
+            worker.join();
+        }
+    }
+
+    // Number of threads a loop runs on, counting the caller
+    size_t size() const
+    {
+        return threads.size() + 1;
+    }
+
+    // Calls body(i) for every i in [0, iterations) across the pool and returns when all are done
+    void parallelFor(size_t iterations, const function<void(size_t)> &loopBody)
+    {
+        unique_lock<mutex> exclusive(dispatch, try_to_lock);
+        if (!exclusive.owns_lock() || threads.empty() || iterations < 2 || iterations > UINT32_MAX)
+        {
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                loopBody(i);
+            }
+            return;
+        }
+
+        size_t participants = size();
+        for (size_t p = 0; p < participants; ++p)
+        {
+            ranges[p].bounds.store(pack(iterations * p / participants, iterations * (p + 1) / participants));
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            body = &loopBody;
+            running = threads.size();
+            ++generation;
+        }
+        wake.notify_all();
+        runIterations(threads.size());
+
+        unique_lock<mutex> guard(lock);
+        finished.wait(guard, [&]
+                      { return running == 0; });
+        body = nullptr;
+    }
+};
+
+// Bitmap over NodeIds in which several threads can set bits at once
+class AtomicBitmap
+{
+    unique_ptr<atomic<uint64_t>[]> words;
+    size_t wordCount = 0;
+
+public:
+    // Makes the bitmap cover ids below `bits`, all clear
+    void resize(size_t bits)
+    {
+        wordCount = (bits + 63) / 64;
+        words.reset(new atomic<uint64_t>[wordCount]);
+        for (size_t i = 0; i < wordCount; ++i)
+        {
+            words[i].store(0, memory_order_relaxed);
+        }
+    }
+
+    size_t wordsUsed() const
+    {
+        return wordCount;
+    }
+
+    atomic<uint64_t> &word(size_t index)
+    {
+        return words[index];
+    }
+
+    bool test(NodeId id) const
+    {
+        return words[id >> 6].load(memory_order_relaxed) & (uint64_t(1) << (id & 63));
+    }
+
+    void set(NodeId id)
+    {
+        words[id >> 6].fetch_or(uint64_t(1) << (id & 63), memory_order_relaxed);
+    }
+
+    // Sets the bit of `id`; returns true only for the one caller that actually set it
+    bool claim(NodeId id)
+    {
+        uint64_t bit = uint64_t(1) << (id & 63);
+        atomic<uint64_t> &target = words[id >> 6];
+        return !(target.load(memory_order_relaxed) & bit) && !(target.fetch_or(bit, memory_order_relaxed) & bit);
+    }
+};
+
+// Level-synchronous breadth-first search that spreads every level over a WorkerPool. While the
+// frontier is small a level is expanded top-down: the frontier's relationships claim unvisited
+// neighbours in an atomic bitmap. Once the frontier's relationships outnumber those of the nodes
+// not reached yet (the huge middle levels of power-law graphs), it switches to bottom-up: every
+// unvisited node scans its incoming relationships for a parent in the frontier and stops at the
+// first, which skips most of the edge checks (direction-optimizing BFS, Beamer et al.).
+class ParallelBfs
+{
+    const vector<vector<Edge>> &outgoing;
+    const vector<vector<Edge>> &incomingEdges;
+    const vector<Symbol> &relations; // Relationship types to follow; empty follows all
+    WorkerPool &pool;
+    size_t nodeCount;
+
+    AtomicBitmap visited, current, next;
+    size_t unexploredEdges; // Outgoing relationships of the nodes not reached yet
+    size_t frontierEdges = 0;
+    bool bottomUp = false;
+
+    // Switching thresholds from the direction-optimizing BFS paper
+    static const size_t Alpha = 14;
+    static const size_t Beta = 24;
+
+    // Work is handed out in chunks of frontier nodes (top-down) or bitmap words (bottom-up)
+    static const size_t FrontierChunk = 64;
+    static const size_t WordChunk = 64;
+
+    vector<vector<NodeId>> chunkNodes;
+    vector<size_t> chunkEdges;
+
+    bool follows(const Edge &edge) const
+    {
+        return relations.empty() ||
+               std::find(relations.begin(), relations.end(), edge.relationship->relation) != relations.end();
+    }
+
+    void topDownStep(const vector<NodeId> &frontier)
+    {
+        pool.parallelFor((frontier.size() + FrontierChunk - 1) / FrontierChunk, [&](size_t chunk)
+                         {
+            size_t end = min(frontier.size(), (chunk + 1) * FrontierChunk);
+            for (size_t i = chunk * FrontierChunk; i < end; ++i)
+            {
+                for (const Edge &edge : outgoing[frontier[i]])
+                {
+                    if (follows(edge) && visited.claim(edge.node))
+                    {
+                        next.set(edge.node);
+                    }
+                }
+            } });
+    }
+
+    void bottomUpStep(const vector<NodeId> &frontier)
+    {
+        for (NodeId node : frontier)
+        {
+            current.set(node);
+        }
+        pool.parallelFor((visited.wordsUsed() + WordChunk - 1) / WordChunk, [&](size_t chunk)
+                         {
+            size_t end = min(visited.wordsUsed(), (chunk + 1) * WordChunk);
+            for (size_t w = chunk * WordChunk; w < end; ++w)
+            {
+                uint64_t unvisited = ~visited.word(w).load(memory_order_relaxed);
+                if (w == visited.wordsUsed() - 1 && nodeCount % 64 != 0)
+                {
+                    unvisited &= (uint64_t(1) << (nodeCount % 64)) - 1;
+                }
+
+                // This chunk owns word w, so found parents are published once per word
+                uint64_t found = 0;
+                while (unvisited)
+                {
+                    unsigned bit = lowestBit(unvisited);
+                    unvisited &= unvisited - 1;
+                    for (const Edge &edge : incomingEdges[w * 64 + bit])
+                    {
+                        if (current.test(edge.node) && follows(edge))
+                        {
+                            found |= uint64_t(1) << bit;
+                            break;
+                        }
+                    }
+                }
+                if (found)
+                {
+                    visited.word(w).fetch_or(found, memory_order_relaxed);
+                    next.word(w).fetch_or(found, memory_order_relaxed);
+                }
+            } });
+        for (NodeId node : frontier)
+        {
+            current.word(node >> 6).store(0, memory_order_relaxed);
+        }
+    }
+
+public:
+    size_t topDownSteps = 0;
+    size_t bottomUpSteps = 0;
+
+    ParallelBfs(const vector<vector<Edge>> &outgoing, const vector<vector<Edge>> &incomingEdges,
+                const vector<Symbol> &relations, WorkerPool &pool, size_t relationshipCount)
+        : outgoing(outgoing), incomingEdges(incomingEdges), relations(relations), pool(pool),
+          nodeCount(outgoing.size()), unexploredEdges(relationshipCount)
+    {
+        visited.resize(nodeCount);
+        current.resize(nodeCount);
+        next.resize(nodeCount);
+    }
+
+    // Records nodes reached before the engine took over (the start node and earlier levels)
+    void markVisited(const vector<NodeId> &nodes)
+    {
+        for (NodeId node : nodes)
+        {
+            visited.set(node);
+            unexploredEdges -= min(unexploredEdges, outgoing[node].size());
+        }
+    }
+
+    // Replaces `frontier`, the last level reached, with the next level in ascending id order
+    void step(vector<NodeId> &frontier)
+    {
+        if (frontierEdges == 0)
+        {
+            for (NodeId node : frontier)
+            {
+                frontierEdges += outgoing[node].size();
+            }
+        }
+        if (!bottomUp && frontierEdges > unexploredEdges / Alpha)
+        {
+            bottomUp = true;
+        }
+        else if (bottomUp && frontier.size() < nodeCount / Beta)
+        {
+            bottomUp = false;
+        }
+
+        if (bottomUp)
+        {
+            bottomUpStep(frontier);
+            ++bottomUpSteps;
+        }
+        else
+        {
+            topDownStep(frontier);
+            ++topDownSteps;
+        }
+
+        // Collect the next level from its bitmap chunk by chunk, which leaves it sorted, and
+        // clear the bitmap for the following step
+        size_t chunks = (next.wordsUsed() + WordChunk - 1) / WordChunk;
+        chunkNodes.resize(chunks);
+        chunkEdges.assign(chunks, 0);
+        pool.parallelFor(chunks, [&](size_t chunk)
+                         {
+            vector<NodeId> &nodes = chunkNodes[chunk];
+            nodes.clear();
+            size_t end = min(next.wordsUsed(), (chunk + 1) * WordChunk);
+            for (size_t w = chunk * WordChunk; w < end; ++w)
+            {
+                uint64_t bits = next.word(w).exchange(0, memory_order_relaxed);
+                while (bits)
+                {
+                    NodeId node = w * 64 + lowestBit(bits);
+                    bits &= bits - 1;
+                    nodes.push_back(node);
+                    chunkEdges[chunk] += outgoing[node].size();
+                }
+            } });
+
+        frontier.clear();
+        frontierEdges = 0;
+        for (size_t chunk = 0; chunk < chunks; ++chunk)
+        {
+            frontier.insert(frontier.end(), chunkNodes[chunk].begin(), chunkNodes[chunk].end());
+            frontierEdges += chunkEdges[chunk];
+        }
+        unexploredEdges -= min(unexploredEdges, frontierEdges);
+    }
+};
+
+// Min-heap with four children per slot: half the depth of a binary heap, and the children of a
+// slot sit next to each other in memory, which makes Dijkstra's many pops cheaper
+template <typename T, typename Less = less<T>>
+class QuaternaryHeap
+{
+    vector<T> items;
+    Less less;
+
+public:
+    bool empty() const
+    {
+        return items.empty();
+    }
+
+    void clear()
+    {
+        items.clear();
+    }
+
+    const T &top() const
+    {
+        return items.front();
+    }
+
+    void push(const T &item)
+    {
+        size_t slot = items.size();
+        items.push_back(item);
+        while (slot > 0)
+        {
+            size_t parent = (slot - 1) / 4;
+            if (!less(item, items[parent]))
+            {
+                break;
+            }
+            items[slot] = items[parent];
+            slot = parent;
+        }
+        items[slot] = item;
+    }
+
+    void pop()
+    {
+        T last = items.back();
+        items.pop_back();
+        if (items.empty())
+        {
+            return;
+        }
+
+        // Sift the former last item down from the root, moving the smallest child up each time
+        size_t slot = 0;
+        while (true)
+        {
+            size_t firstChild = slot * 4 + 1;
+            if (firstChild >= items.size())
+            {
+                break;
+            }
+            size_t smallest = firstChild;
+            size_t lastChild = min(firstChild + 4, items.size());
+            for (size_t child = firstChild + 1; child < lastChild; ++child)
+            {
+                if (less(items[child], items[smallest]))
+                {
+                    smallest = child;
+                }
+            }
+            if (!less(items[smallest], last))
+            {
+                break;
+            }
+            items[slot] = items[smallest];
+            slot = smallest;
+        }
+        items[slot] = last;
+    }
+};
+
+// Relationship weights for one property key in CSR form, in both directions. In `forward` the
+// relationships leaving node i are targets[k] / weights[k] for k in [offsets[i], offsets[i + 1]);
+// `backward` lists the relationships arriving at each node the same way, with their sources.
+// Weighted searches read these flat arrays instead of hashing into every relationship's
+// properties and parsing the value again.
+struct WeightedAdjacency
+{
+    struct Csr
+    {
+        vector<uint64_t> offsets;
+        vector<NodeId> targets;
+        vector<double> weights;
+    };
+
+    Csr forward, backward;
+    size_t skipped = 0; // Relationships without a usable (numeric, non-negative) weight
+    double scale = 1;   // Weights are stored times this power of two, so that no path total overflows
+};
+
+// The relationships PageRank follows, transposed into CSR form: the sources of the relationships
+// arriving at node v are sources[k] for k in [offsets[v], offsets[v + 1]), and outDegree[u] counts
+// those leaving u. An iteration pulls every score from its sources, so threads never write to the
+// same score.
+struct RankAdjacency
+{
+    vector<uint64_t> offsets;
+    vector<NodeId> sources;
+    vector<uint32_t> outDegree;
+};
+
+// Weakly connected components (relationship direction and type ignored) as a union-find over
+// NodeIds. New relationships merge two components in near-constant time; a removed one may split
+// a component, which union-find cannot undo, so removals only mark the structure dirty and Graph
+// rebuilds it from scratch before the next query reads it.
+class ComponentIndex
+{
+    vector<NodeId> parent;
+    vector<uint32_t> sizes; // Entities in the component, valid at roots only
+    bool dirty = false;
+
+public:
+    bool isDirty() const
+    {
+        return dirty;
+    }
+
+    void markDirty()
+    {
+        dirty = true;
+    }
+
+    // Makes `node` a component of its own (a new node, or a reused slot)
+    void addNode(NodeId node)
+    {
+        if (node >= parent.size())
+        {
+            parent.resize(node + 1);
+            sizes.resize(node + 1);
+        }
+        parent[node] = node;
+        sizes[node] = 1;
+    }
+
+    // Root of the component of `node`, halving the path on the way up
+    NodeId find(NodeId node)
+    {
+        while (parent[node] != node)
+        {
+            parent[node] = parent[parent[node]];
+            node = parent[node];
+        }
+        return node;
+    }
+
+    void unite(NodeId a, NodeId b)
+    {
+        if (dirty)
+        {
+            return; // The rebuild sees the relationship anyway
+        }
+        a = find(a);
+        b = find(b);
+        if (a == b)
+        {
+            return;
+        }
+        if (sizes[a] < sizes[b])
+        {
+            swap(a, b);
+        }
+        parent[b] = a;
+        sizes[a] += sizes[b];
+    }
+
+    uint32_t sizeOf(NodeId node)
+    {
+        return sizes[find(node)];
+    }
+
+    // Replaces the structure with the given component labels: every node points straight at
+    // its label, the smallest id in its component; `live` tells which slots hold an entity
+    void rebuild(vector<NodeId> &&labels, const function<bool(NodeId)> &live)
+    {
+        parent = move(labels);
+        sizes.assign(parent.size(), 0);
+        for (NodeId node = 0; node < parent.size(); ++node)
+        {
+            sizes[parent[node]] += live(node);
+        }
+        dirty = false;
+    }
+};
+
+// String-keyed map holding at most `capacity` entries; inserting into a full cache evicts the
+// entry that was looked up or inserted longest ago
+template <typename Value>
+class LruCache
+{
+    using Entries = list<pair<string, Value>>;
+
+    Entries entries; // Most recently used first
+    unordered_map<string_view, typename Entries::iterator> index; // Keys point into `entries`
+    size_t capacity;
+    size_t evicted = 0;
+
+public:
+    explicit LruCache(size_t capacity) : capacity(max<size_t>(1, capacity)) {}
+
+    // Returns the value of `key` and marks it most recently used, or nullptr if absent
+    Value *find(string_view key)
+    {
+        auto it = index.find(key);
+        if (it == index.end())
+        {
+            return nullptr;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        return &it->second->second;
+    }
+
+    Value &insert(string key, Value value)
+    {
+        if (Value *existing = find(key))
+        {
+            *existing = move(value);
+            return *existing;
+        }
+        entries.emplace_front(move(key), move(value));
+        index.emplace(entries.front().first, entries.begin());
+        shrinkTo(capacity);
+        return entries.front().second;
+    }
+
+    void setCapacity(size_t newCapacity)
+    {
+        capacity = max<size_t>(1, newCapacity);
+        shrinkTo(capacity);
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    size_t maxSize() const
+    {
+        return capacity;
+    }
+
+    size_t evictions() const
+    {
+        return evicted;
+    }
+
+private:
+    void shrinkTo(size_t limit)
+    {
+        while (entries.size() > limit)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+            ++evicted;
+        }
+    }
+};
+
+// Layout of a graph image (EXPORT_IMAGE{path}, served read-only with --image path). The file is
+// one header followed by flat arrays; every reference is an offset from the start of the file, so
+// the image can be mapped at any address and used in place without parsing or allocating.
+//   strings:     every name, symbol and property value, back to back (not terminated)
+//   symbols:     ImageString per symbol handle, plus the handles sorted by text for lookups
+//   nodes:       ImageNode per entity, sorted by name so FIND / GET_INFO binary search them
+//   adjacency:   CSR form, edgeOffsets[i]..edgeOffsets[i + 1] index the outgoing ImageEdges of node i
+//   properties:  ImageProperty blocks, one contiguous run per node
+//   labels:      ImageLabel per label symbol, each a range of labelMembers (node indexes by name)
+struct ImageString
+{
+    uint64_t offset; // Relative to the string section
+    uint32_t length;
+    uint32_t reserved;
+};
+
+struct ImageNode
+{
+    ImageString name;
+    Symbol label;
+    uint32_t propertyCount;
+    uint64_t firstProperty;
+};
+
+struct ImageProperty
+{
+    ImageString value;
+    Symbol key;
+    uint32_t reserved;
+};
+
+struct ImageEdge
+{
+    uint32_t target; // Node index in the image
+    Symbol relation;
+};
+
+struct ImageLabel
+{
+    Symbol label;
+    uint32_t reserved;
+    uint64_t firstMember;
+    uint64_t memberCount;
+};
+
+struct ImageSection
+{
+    uint64_t offset; // From the start of the file, 8-byte aligned
+    uint64_t count;  // Number of elements (bytes for the string section)
+};
+
+struct ImageHeader
+{
+    char magic[8]; // "GDBIMG01"
+    uint64_t fileSize;
+    ImageSection strings, symbols, symbolsByName, nodes, edgeOffsets, edges, properties, labels, labelMembers;
+};
+
+class Graph
+{
+
+    // Slab allocators owning every Node and Relationship of the graph
+    SlabPool<Node> nodePool;
+    SlabPool<Relationship> relationshipPool;
+
+    // Durability (enabled by openStorage): every mutating query is appended to the write-ahead
+    // log before it runs, and CHECKPOINT writes a snapshot so the log can start over.
+    WriteAheadLog wal;
+    string dataDirectory;
+    size_t checkpointEvery = 0; // Automatic checkpoint after this many logged queries (0 = off)
+    size_t loggedSinceCheckpoint = 0;
+    bool replaying = false;
+
+    // Off while serving socket clients (main), who must not make the server read or write
+    // arbitrary files with BULK_LOAD or EXPORT_IMAGE
+    bool fileCommandsAllowed = true;
+
+    // Pool for traversals that outgrow one thread (set by main with --threads, or a benchmark).
+    // A BFS level whose frontier reaches parallelFrontier nodes moves to the parallel engine.
+    WorkerPool *workers = nullptr;
+    size_t parallelFrontier = 4096;
+
+    // Readers share this lock, so any number of read queries run at once; a query that changes
+    // the graph takes it exclusively and waits for the readers in flight to finish.
+    mutable shared_mutex graphMutex;
+
+    // Bumped by every query that changes the graph, so views derived from it can tell they are stale
+    uint64_t version = 0;
+
+    // Weight columns built for SHORTEST_PATH, per property key, with the version they were built
+    // at. Readers share it, so it has its own lock.
+    mutex weightCacheMutex;
+    unordered_map<Symbol, pair<uint64_t, shared_ptr<const WeightedAdjacency>>> weightCache;
+
+    // Maps each node's unique name to its id. Only used to resolve names coming in with a query.
+    unordered_map<string, NodeId> nodeIds;
+
+    // Node objects indexed by NodeId. Slots of deleted nodes hold nullptr until reused via freeIds.
+    vector<Node *> nodeTable;
+    vector<NodeId> freeIds;
+
+    // Provides a label-based index for fast lookup of nodes by type.
+    // Each label (e.g., "Person") maps to a set of Node pointers that have that label.
+    unordered_map<Symbol, unordered_set<Node *>> labelIndex;
+
+    // Optional (key, value) -> nodes indexes created with CREATE_INDEX{Key}, used by GET{...}
+    PropertyIndex propertyIndex;
+
+    // Optional columnar copies of numeric properties per label, created with CREATE_COLUMNS and
+    // read by SCAN. Kept in step with every change to an entity of the label.
+    unordered_map<Symbol, LabelTable> labelTables;
+
+    // Outgoing relationships of every node, indexed by NodeId: (to node id, Relationship*).
+    vector<vector<Edge>> relationships;
+
+    // Reverse index of `relationships`, indexed by NodeId: (from node id, Relationship*).
+    // The Relationship objects are shared with `relationships`, so removing a node only has to
+    // visit the edges that actually touch it instead of scanning every edge in the graph.
+    vector<vector<Edge>> incoming;
+
+    // Direct (from, to) -> Relationship* lookup. Each pair of nodes has at most one
+    // relationship, so this answers every "relationship between A and B" query in constant time.
+    unordered_map<uint64_t, Relationship *, edge_key_hash> edgeIndex;
+
+    // Number of relationships of each type, kept by link/unlink; MATCH plans with it
+    unordered_map<Symbol, size_t> relationCounts;
+
+    // Connected components, merged by link and marked dirty by unlink. Writers change it while
+    // holding the graph exclusively; readers go through componentMutex, since finding a root and
+    // the rebuild after a removal both write to it.
+    mutex componentMutex;
+    ComponentIndex components;
+
+    // Resolves a node name to its id, or InvalidNode if there is no such node
+    NodeId lookupNode(const string &name) const
+    {
+        auto it = nodeIds.find(name);
+        return it != nodeIds.end() ? it->second : InvalidNode;
+    }
+
+    // Returns the relationship from node `from` to node `to`, or nullptr if there is none
+    Relationship *findRelationship(NodeId from, NodeId to) const
+    {
+        auto it = edgeIndex.find(edgeKey(from, to));
+        return it != edgeIndex.end() ? it->second : nullptr;
+    }
+
+    // Appends a relationship to both adjacency lists and the edge index
+    void linkRelationship(NodeId from, NodeId to, Relationship *relationship)
+    {
+        relationship->from = from;
+        relationship->to = to;
+        relationship->outSlot = relationships[from].size();
+        relationship->inSlot = incoming[to].size();
+        relationships[from].push_back({to, relationship});
+        incoming[to].push_back({from, relationship});
+        edgeIndex[edgeKey(from, to)] = relationship;
+        ++relationCounts[relationship->relation];
+        components.unite(from, to);
+    }
+
+    // Removes a relationship from both adjacency lists and the edge index in constant time by
+    // moving the last entry of each list into its slot. The Relationship object itself is not freed.
+    void unlinkRelationship(Relationship *relationship)
+    {
+        vector<Edge> &outList = relationships[relationship->from];
+        Edge movedOut = outList.back();
+        outList[relationship->outSlot] = movedOut;
+        movedOut.relationship->outSlot = relationship->outSlot;
+        outList.pop_back();
+
+        vector<Edge> &inList = incoming[relationship->to];
+        Edge movedIn = inList.back();
+        inList[relationship->inSlot] = movedIn;
+        movedIn.relationship->inSlot = relationship->inSlot;
+        inList.pop_back();
+
+        edgeIndex.erase(edgeKey(relationship->from, relationship->to));
+        --relationCounts[relationship->relation];
+        components.markDirty();
+    }
+
+    // Creates a node without printing anything. Returns its id, or InvalidNode if the name is taken.
+    NodeId insertNode(Symbol label, const string &name)
+    {
+        auto inserted = nodeIds.emplace(name, InvalidNode);
+        if (!inserted.second)
+        {
+            return InvalidNode;
+        }
+
+        // Create a new Node in a free slot of the node table (or a new one) and register its name
+        Node *newNode = nodePool.create(label, name);
+        if (!freeIds.empty())
+        {
+            newNode->id = freeIds.back();
+            freeIds.pop_back();
+            nodeTable[newNode->id] = newNode;
+        }
+        else
+        {
+            newNode->id = nodeTable.size();
+            nodeTable.push_back(newNode);
+            relationships.emplace_back();
+            incoming.emplace_back();
+        }
+        inserted.first->second = newNode->id;
+        components.addNode(newNode->id);
+
+        // Insert the node into labelIndex for efficient lookup by label
+        labelIndex[label].insert(newNode);
+        if (LabelTable *table = labelTableOf(newNode))
+        {
+            table->addRow(newNode);
+        }
+        return newNode->id;
+    }
+
+    // Sets a node property and keeps the property index in step
+    void setNodeProperty(Node *node, Symbol key, const string &value)
+    {
+        // Move the node from the old value's index bucket to the new one
+        auto oldIt = node->properties.find(key);
+        if (oldIt != node->properties.end())
+        {
+            propertyIndex.remove(node, key, oldIt->second);
+        }
+        node->updateProperty(key, value); // Update node's property
+        const PropertyValue &stored = node->properties[key];
+        propertyIndex.add(node, key, stored);
+        if (LabelTable *table = labelTableOf(node))
+        {
+            table->set(node, key, stored);
+        }
+    }
+
+    // Returns the columnar table of the node's label, or nullptr if the label has none
+    LabelTable *labelTableOf(const Node *node)
+    {
+        auto it = labelTables.find(node->label);
+        return it != labelTables.end() ? &it->second : nullptr;
+    }
+
+    // Creates the relationship from -> to, or changes the type of the existing one, without
+    // printing anything. Returns the relationship and whether it was newly created.
+    pair<Relationship *, bool> insertRelationship(NodeId from, NodeId to, Symbol relation)
+    {
+        Relationship *existing = findRelationship(from, to);
+        if (existing)
+        {
+            --relationCounts[existing->relation];
+            ++relationCounts[relation];
+            existing->relation = relation;
+            return {existing, false};
+        }
+
+        // Add the new relationship to both adjacency lists and the edge index
+        Relationship *relationship = relationshipPool.create(relation);
+        linkRelationship(from, to, relationship);
+        return {relationship, true};
+    }
+
+public:
+    Graph() = default;
+    Graph(const Graph &) = delete;
+    Graph &operator=(const Graph &) = delete;
+
+    // Dropping the graph runs the destructors of the remaining entities (their property maps
+    // own heap memory) and then hands the slabs back in one go instead of freeing object by object
+    ~Graph()
+    {
+        for (const auto &edge : edgeIndex)
+        {
+            edge.second->~Relationship();
+        }
+        for (Node *node : nodeTable)
+        {
+            if (node)
+            {
+                node->~Node();
+            }
+        }
+        relationshipPool.releaseAll();
+        nodePool.releaseAll();
+    }
+
+    void addNode(const string &label, const string &name)
+    {
+        // Check if a node with the same name already exists
+        if (insertNode(symbols.intern(label), name) == InvalidNode)
+        {
+            out << "{\"error\": \"A Entity with the name \"" << name << "\" already exists.\"}" << endl;
+            return;
+        }
+
+        // JSON feedback indicating successful addition
+        out << "{\"status\": \"success\", \"message\": \"Entity with label \""
+            << label << "\" and name \"" << name << "\" added successfully.\"}" << endl;
+    }
+
+    void addNodeProperty(const string &name, const string &key, const string &value)
+    {
+        // Check if node exists in the graph using its unique name
+        NodeId id = lookupNode(name);
+        if (id != InvalidNode)
+        {
+            setNodeProperty(nodeTable[id], symbols.intern(key), value);
+        }
+        else
+        {
+            out << "{\"error\": \"Entity with name \"" << name << "\" does not exist.\"}" << endl;
+        }
+    }
+
+    void getNodeProperty(const string &name, const vector<string> &keys)
+    {
+        // Check if the node exists in the graph
+        NodeId id = lookupNode(name);
+        if (id == InvalidNode)
+        {
+            out << "{\"error\": \"Entity \"" << name << "\" does not exist in the database.\"}" << endl;
+            return;
+        }
+
+        Node *node = nodeTable[id]; // Retrieve the node
+
+        // If "ALL" is specified in the keys, print all properties
+        if (keys.size() == 1 && keys[0] == "ALL")
+        {
+            node->printProperties();
+            return;
+        }
+
+        // If specific keys are provided, iterate through each key and print each property
+        out << "{\n";
+        out << "  \"Label\": \"" << symbols.name(node->label) << "\",\n";
+        out << "  \"Name\": \"" << name << "\",\n";
+        out << "  \"Properties\": {\n";
+
+        bool firstProperty = true;
+        for (const auto &key : keys)
+        {
+            if (!firstProperty)
+            {
+                out << ",\n";
+            }
+            out << "    ";
+            node->getProperty(key); // Display each property
+            firstProperty = false;
+        }
+
+        out << "\n  }\n";
+        out << "}" << endl;
+    }
+
+    void deleteNodeProperty(const string &name, const vector<string> &keys)
+    {
+        // Check if node exists
+        NodeId id = lookupNode(name);
+        if (id == InvalidNode)
+        {
+            out << "{\"error\": \"Entity '" << name << "' not found in the database.\"}" << endl;
+            return;
+        }
+
+        Node *node = nodeTable[id];
+
+        // Check if the keys contain "ALL"
+        if (keys.size() == 1 && keys[0] == "ALL")
+        {
+            // Clear all properties if "ALL" is specified
+            propertyIndex.removeAll(node);
+            if (LabelTable *table = labelTableOf(node))
+            {
+                table->clearRow(node);
+            }
+            node->clearProperties();
+            out << "{\"status\": \"success\", \"message\": \"All properties for entity '" << name << "' have been cleared.\"}" << endl;
+            return;
+        }
+
+        // Iterate through each key and delete if it exists
+        bool anyKeyFound = false;
+        for (const string &key : keys)
+        {
+            Symbol keySymbol = symbols.find(key);
+            auto propertyIt = node->properties.find(keySymbol);
+            if (propertyIt != node->properties.end())
+            {
+                // Delete the specific property if it exists
+                propertyIndex.remove(node, keySymbol, propertyIt->second);
+                if (LabelTable *table = labelTableOf(node))
+                {
+                    table->clear(node, keySymbol);
+                }
+                node->deleteProperty(keySymbol);
+                anyKeyFound = true;
+            }
+            else
+            {
+                out << "{\"warning\": \"Property '" << key << "' not found for entity '" << name << "'.\"}" << endl;
+            }
+        }
+
+        // If none of the specified keys were found, notify the user
+        if (!anyKeyFound)
+        {
+            out << "{\"error\": \"None of the specified properties were found for entity '" << name << "'.\"}" << endl;
+        }
+        else
+        {
+            out << "{\"status\": \"success\", \"message\": \"Specified properties for entity '" << name << "' have been deleted where found.\"}" << endl;
+        }
+    }
+
+    void getNodesByLabel(const string &label)
+    {
+        // Check if the label exists in the index
+        auto it = labelIndex.find(symbols.find(label));
+        if (it != labelIndex.end())
+        {
+            // Start JSON object
+            out << "{" << endl;
+            out << "  \"label\": \"" << label << "\"," << endl;
+            out << "  \"entities\": [" << endl;
+
+            int count = 0;
+            int totalNodes = it->second.size();
+
+            for (auto node : it->second)
+            {
+                // Print each node's name
+                out << "    \"" << node->name << "\"";
+
+                // Add a comma if this is not the last node
+                if (++count < totalNodes)
+                {
+                    out << ",";
+                }
+                out << endl;
+            }
+
+            out << "  ]" << endl; // Close the entities array
+            out << "}" << endl;   // Close the JSON object
+        }
+        else
+        {
+            out << "Error: Label \"" << label << "\" does not exist." << endl;
+        }
+    }
+
+    void addRelationship(const string &nodeName1, const string &nodeName2, const string &relationshipType)
+    {
+        // Check if both nodes exist in the graph
+        NodeId from = lookupNode(nodeName1);
+        NodeId to = lookupNode(nodeName2);
+        if (from == InvalidNode || to == InvalidNode)
+        {
+            out << "{\"error\": \"One or both nodes not found in the graph.\"}" << endl;
+            return; // Exit the function if either node does not exist
+        }
+
+        // Add the relationship, or update the type of the one that already exists
+        bool added = insertRelationship(from, to, symbols.intern(relationshipType)).second;
+
+        if (!added)
+        {
+            out << "{\"status\": \"success\", \"message\": \"Updated relationship between \"" << nodeName1 << "\" and \"" << nodeName2 << "\" to \"" << relationshipType << "\"." << endl;
+        }
+        else
+        {
+            out << "{\"status\": \"success\", \"message\": \"Added relationship between \"" << nodeName1 << "\" and \"" << nodeName2 << "\" as \"" << relationshipType << "\"." << endl;
+        }
+    }
+
+    void addRelationshipProperty(const string &name1, const string &name2, const string &key, const string &value)
+    {
+        // Check if there are relationships for name1
+        NodeId from = lookupNode(name1);
+        if (from == InvalidNode || relationships[from].empty())
+        {
+            out << "{\"error\": \"No relationships found for node \"" << name1 << "\".\"}" << endl;
+            return;
+        }
+
+        // Find the relationship to name2 through the edge index
+        NodeId to = lookupNode(name2);
+        Relationship *relationship = to != InvalidNode ? findRelationship(from, to) : nullptr;
+
+        // Check if the relationship exists
+        if (!relationship)
+        {
+            out << "{\"error\": \"No relationship exists between \"" << name1 << "\" and \"" << name2 << "\".\"}" << endl;
+            return;
+        }
+
+        // Set or update the specified property of the relationship
+        relationship->setProperty(symbols.intern(key), value);
     }
 
     void getRelationshipProperty(const string &name1, const string &name2, const vector<string> &keys)
     {
-        // Check if there are relationships for name1
-        if (relationships.find(name1) == relationships.end())
+        // Check if there are relationships for name1
+        NodeId from = lookupNode(name1);
+        if (from == InvalidNode || relationships[from].empty())
+        {
+            out << "{\"error\": \"No relationships found for node \"" << name1 << "\".\"}" << endl;
+            return;
+        }
+
+        // Find the relationship to name2 through the edge index
+        NodeId to = lookupNode(name2);
+        Relationship *relationship = to != InvalidNode ? findRelationship(from, to) : nullptr;
+
+        // Check if the relationship exists
+        if (!relationship)
+        {
+            out << "{\"error: \"No relationship exists between \"" << name1 << "\" and \"" << name2 << "\".\"}" << endl;
+            return;
+        }
+
+        // If "ALL" is the only key, display all properties
+        if (keys.size() == 1 && keys[0] == "ALL")
+        {
+            relationship->displayRelationship();
+        }
+        else
+        {
+            // Output properties in JSON-like format
+            out << "{" << endl;
+            out << "  \"Relationship\": \"" << symbols.name(relationship->relation) << "\",\n  \"Properties\": {\n";
+            bool first = true; // Flag to manage commas between properties
+            for (const string &key : keys)
+            {
+                string value = relationship->getProperty(symbols.find(key));
+                if (!value.empty())
+                {
+                    if (!first)
+                    {
+                        out << ",\n"; // Add comma for all but the first element
+                    }
+                    out << "    \"" << key << "\": \"" << value << "\"";
+                    first = false;
+                }
+                else
+                {
+                    out << "    // Property \"" << key << "\" not found\n";
+                }
+            }
+            out << "\n  }\n";
+            out << "}" << endl;
+        }
+    }
+
+    void deleteRelationshipProperty(const string &name1, const string &name2, const vector<string> &keys)
+    {
+        // Check if there are relationships for name1
+        NodeId from = lookupNode(name1);
+        if (from == InvalidNode || relationships[from].empty())
+        {
+            out << "{\"error\": \"No relationships found for node \"" << name1 << "\".\"}" << endl;
+            return;
+        }
+
+        // Find the relationship to name2 through the edge index
+        NodeId to = lookupNode(name2);
+        Relationship *relationship = to != InvalidNode ? findRelationship(from, to) : nullptr;
+
+        // Check if the relationship exists
+        if (!relationship)
+        {
+            out << "{\"error\": \"No relationship exists between \"" << name1 << "\" and \"" << name2 << "\".\"}" << endl;
+            return;
+        }
+
+        // If "ALL" is the only key, clear all properties
+        if (keys.size() == 1 && keys[0] == "ALL")
+        {
+            relationship->clearProperties();
+            out << "{\"status\": \"success\", \"message\": \"All properties for the relationship between \"" << name1 << "\" and \"" << name2 << "\" have been cleared.\"}" << endl;
+        }
+        else
+        {
+            // Otherwise, remove each specified property by key
+            for (const string &key : keys)
+            {
+                relationship->removeProperty(key);
+                out << "{\"status\": \"success\", \"message\": \"Property \"" << key << "\" has been removed from the relationship between \""
+                    << name1 << "\" and \"" << name2 << "\".\"}" << endl;
+            }
+        }
+    }
+
+    void retrieveRelatedNodes(const string &name, const vector<string> &relations)
+    {
+        // Check if the specified node exists in the graph
+        NodeId id = lookupNode(name);
+        if (id == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << name << "\\\" does not exist.\"}" << endl;
+            return;
+        }
+
+        // Translate the requested relationship types to symbols once, so each edge is
+        // matched with an integer comparison (unknown types can never match)
+        bool allRelations = relations.empty() || (relations.size() == 1 && relations[0] == "ALL");
+        vector<Symbol> relationSymbols;
+        for (const string &relation : relations)
+        {
+            relationSymbols.push_back(symbols.find(relation));
+        }
+
+        out << "{\"related entities\": [";
+
+        // Iterate over the relationships associated with the specified node
+        if (!relationships[id].empty())
+        {
+            bool found = false; // To track if any related nodes are printed
+            for (const Edge &edge : relationships[id])
+            {
+                // If ALL is specified, print all relationships
+                if (allRelations ||
+                    (std::find(relationSymbols.begin(), relationSymbols.end(), edge.relationship->relation) != relationSymbols.end()))
+                {
+                    out << "\n                      {\"name\": \"" << nodeTable[edge.node]->name << "\", \"relationship\": \"" << symbols.name(edge.relationship->relation) << "\"}, ";
+                    found = true;
+                }
+            }
+            if (found)
+            {
+                out << "\b\b"; // Remove the last comma and space
+            }
+            else
+            {
+                out << "{\"message\": \"No related nodes found for the specified relationship.\"}";
+            }
+        }
+        else
+        {
+            out << "{\"message\": \"No relationships found for this node.\"}";
+        }
+
+        out << "\n                   ]\n}" << endl; // Closing JSON array and object
+    }
+
+    void retrieveIncomingNodes(const string &name, const vector<string> &relations)
+    {
+        // Check if the specified node exists in the graph
+        NodeId id = lookupNode(name);
+        if (id == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << name << "\\\" does not exist.\"}" << endl;
+            return;
+        }
+
+        // Translate the requested relationship types to symbols once (unknown types can never match)
+        vector<Symbol> relationSymbols;
+        for (const string &relation : relations)
+        {
+            relationSymbols.push_back(symbols.find(relation));
+        }
+
+        out << "{\"incoming entities\": [";
+
+        // The reverse index holds every node that has a relationship pointing at this one
+        if (!incoming[id].empty())
+        {
+            bool found = false; // To track if any related nodes are printed
+            for (const Edge &edge : incoming[id])
+            {
+                // If ALL is specified, print all relationships
+                if (relationSymbols.empty() ||
+                    (std::find(relationSymbols.begin(), relationSymbols.end(), edge.relationship->relation) != relationSymbols.end()))
+                {
+                    if (found)
+                    {
+                        out << ",";
+                    }
+                    out << "\n                      {\"name\": \"" << nodeTable[edge.node]->name << "\", \"relationship\": \"" << symbols.name(edge.relationship->relation) << "\"}";
+                    found = true;
+                }
+            }
+            if (!found)
+            {
+                out << "{\"message\": \"No incoming nodes found for the specified relationship.\"}";
+            }
+        }
+        else
+        {
+            out << "{\"message\": \"No incoming relationships found for this node.\"}";
+        }
+
+        out << "\n                   ]\n}" << endl; // Closing JSON array and object
+    }
+
+    // Breadth-first search from `start` over outgoing relationships of the given types (all if
+    // none), at most `depth` levels deep. Calls onLevel(hop, nodes) for every level reached, with
+    // the level's nodes in ascending id order. Levels are expanded on this thread until a frontier
+    // reaches parallelFrontier nodes; from then on, if a worker pool is set, the parallel engine
+    // continues the search. Returns the number of parallel steps taken.
+    template <typename LevelCallback>
+    size_t breadthFirst(NodeId start, size_t depth, const vector<Symbol> &relationSymbols, LevelCallback onLevel)
+    {
+        // Each reader thread keeps its own bitmap and frontiers between queries
+        static thread_local VisitedSet visited;
+        static thread_local vector<NodeId> frontier, reached;
+        visited.reset(nodeTable.size());
+        visited.insert(start);
+        frontier.assign(1, start);
+        reached.assign(1, start);
+
+        size_t hop = 1;
+        for (; hop <= depth && !frontier.empty(); ++hop)
+        {
+            if (workers && frontier.size() >= parallelFrontier)
+            {
+                break;
+            }
+            size_t levelStart = reached.size();
+            for (NodeId node : frontier)
+            {
+                for (const Edge &edge : relationships[node])
+                {
+                    if ((relationSymbols.empty() ||
+                         std::find(relationSymbols.begin(), relationSymbols.end(), edge.relationship->relation) != relationSymbols.end()) &&
+                        visited.insert(edge.node))
+                    {
+                        reached.push_back(edge.node);
+                    }
+                }
+            }
+            frontier.assign(reached.begin() + levelStart, reached.end());
+            sort(frontier.begin(), frontier.end());
+            if (!frontier.empty())
+            {
+                onLevel(hop, frontier);
+            }
+        }
+        if (hop > depth || frontier.empty())
+        {
+            return 0;
+        }
+
+        // Hand the rest over to the parallel engine, seeded with everything reached so far
+        ParallelBfs engine(relationships, incoming, relationSymbols, *workers, edgeIndex.size());
+        engine.markVisited(reached);
+        vector<NodeId> level = frontier;
+        for (; hop <= depth && !level.empty(); ++hop)
+        {
+            engine.step(level);
+            if (!level.empty())
+            {
+                onLevel(hop, level);
+            }
+        }
+        return engine.topDownSteps + engine.bottomUpSteps;
+    }
+
+    // Lists every entity reachable from `name` over at most `depth` outgoing relationships (of the
+    // given types, or any type if none are given), each with its hop distance, nearest first.
+    void expandNeighborhood(const string &name, size_t depth, const vector<string> &relations)
+    {
+        NodeId start = lookupNode(name);
+        if (start == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << name << "\\\" does not exist.\"}" << endl;
+            return;
+        }
+        vector<Symbol> relationSymbols;
+        for (const string &relation : relations)
+        {
+            relationSymbols.push_back(symbols.find(relation));
+        }
+
+        out << "{" << endl;
+        out << "  \"start\": \"" << name << "\"," << endl;
+        out << "  \"depth\": " << depth << "," << endl;
+        out << "  \"entities\": [";
+        bool first = true;
+        breadthFirst(start, depth, relationSymbols, [&](size_t hop, const vector<NodeId> &level)
+                     {
+            for (NodeId node : level)
+            {
+                out << (first ? "\n" : ",\n") << "    {\"name\": \"" << nodeTable[node]->name << "\", \"hops\": " << hop << "}";
+                first = false;
+            } });
+        out << (first ? "]" : "\n  ]") << endl;
+        out << "}" << endl;
+    }
+
+    // Like EXPAND, but reports only how many entities each level adds, for expansions too large to
+    // list (a hub's 3- or 4-hop neighbourhood can be most of the graph)
+    void expandStatistics(const string &name, size_t depth, const vector<string> &relations)
+    {
+        NodeId start = lookupNode(name);
+        if (start == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << name << "\\\" does not exist.\"}" << endl;
+            return;
+        }
+        vector<Symbol> relationSymbols;
+        for (const string &relation : relations)
+        {
+            relationSymbols.push_back(symbols.find(relation));
+        }
+
+        auto started = chrono::steady_clock::now();
+        vector<size_t> levelSizes;
+        size_t total = 0;
+        size_t parallelSteps = breadthFirst(start, depth, relationSymbols, [&](size_t, const vector<NodeId> &level)
+                                            {
+            levelSizes.push_back(level.size());
+            total += level.size(); });
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+        out << "{\"start\": \"" << name << "\", \"reached\": " << total << ", \"levels\": [";
+        for (size_t i = 0; i < levelSizes.size(); ++i)
+        {
+            out << (i ? ", " : "") << levelSizes[i];
+        }
+        out << "], \"parallel_steps\": " << parallelSteps << ", \"milliseconds\": " << static_cast<uint64_t>(seconds * 1000) << "}" << endl;
+    }
+
+    // Lets traversals use `pool` once a frontier reaches `frontierThreshold` nodes (0 = always)
+    void setWorkerPool(WorkerPool *pool, size_t frontierThreshold = 4096)
+    {
+        workers = pool;
+        parallelFrontier = frontierThreshold;
+    }
+
+    // Returns the weight column of `key` for the current graph, building it on first use after a change
+    shared_ptr<const WeightedAdjacency> weightedAdjacency(Symbol key)
+    {
+        lock_guard<mutex> guard(weightCacheMutex);
+        auto cached = weightCache.find(key);
+        if (cached != weightCache.end() && cached->second.first == version)
+        {
+            return cached->second.second;
+        }
+        if (cached != weightCache.end())
+        {
+            weightCache.clear(); // The graph changed, so every column is stale
+        }
+
+        // Pass 1: the relationships in CSR order, reading only the adjacency lists
+        size_t nodeCount = relationships.size();
+        vector<const Relationship *> ordered;
+        vector<NodeId> orderedTargets;
+        vector<uint64_t> orderedOffsets(nodeCount + 1, 0);
+        ordered.reserve(edgeIndex.size());
+        orderedTargets.reserve(edgeIndex.size());
+        for (NodeId node = 0; node < nodeCount; ++node)
+        {
+            for (const Edge &edge : relationships[node])
+            {
+                ordered.push_back(edge.relationship);
+                orderedTargets.push_back(edge.node);
+            }
+            orderedOffsets[node + 1] = ordered.size();
+        }
+
+        // Pass 2: look the weights up. Relationships are scattered over memory, so each one, and
+        // then its first property, is prefetched a few iterations before it is read.
+        const size_t Ahead = 16;
+        vector<double> orderedWeights(ordered.size());
+        for (size_t k = 0; k < ordered.size(); ++k)
+        {
+            if (k + Ahead < ordered.size())
+            {
+                prefetch(ordered[k + Ahead]);
+            }
+            if (k + Ahead / 2 < ordered.size() && !ordered[k + Ahead / 2]->properties.empty())
+            {
+                prefetch(&*ordered[k + Ahead / 2]->properties.begin());
+            }
+
+            // Relationships carry few properties, so walking them beats hashing the key
+            const auto &properties = ordered[k]->properties;
+            auto property = properties.begin();
+            if (properties.size() <= 8)
+            {
+                while (property != properties.end() && property->first != key)
+                {
+                    ++property;
+                }
+            }
+            else
+            {
+                property = properties.find(key);
+            }
+            double weight;
+            bool usable = property != properties.end() && parseNumber(property->second, weight) && weight >= 0;
+            orderedWeights[k] = usable ? weight : -1;
+        }
+
+        // Pass 3: keep the usable relationships, then sort them by target for the backward CSR
+        auto adjacency = make_shared<WeightedAdjacency>();
+        WeightedAdjacency::Csr &forward = adjacency->forward;
+        WeightedAdjacency::Csr &backward = adjacency->backward;
+        forward.offsets.assign(nodeCount + 1, 0);
+        backward.offsets.assign(nodeCount + 1, 0);
+        for (NodeId node = 0; node < nodeCount; ++node)
+        {
+            for (uint64_t k = orderedOffsets[node]; k < orderedOffsets[node + 1]; ++k)
+            {
+                if (orderedWeights[k] < 0)
+                {
+                    ++adjacency->skipped;
+                    continue;
+                }
+                forward.targets.push_back(orderedTargets[k]);
+                forward.weights.push_back(orderedWeights[k]);
+                ++backward.offsets[orderedTargets[k] + 1];
+            }
+            forward.offsets[node + 1] = forward.targets.size();
+        }
+        for (NodeId node = 0; node < nodeCount; ++node)
+        {
+            backward.offsets[node + 1] += backward.offsets[node];
+        }
+        backward.targets.resize(forward.targets.size());
+        backward.weights.resize(forward.targets.size());
+        vector<uint64_t> fill(backward.offsets.begin(), backward.offsets.end() - 1);
+        for (NodeId node = 0; node < nodeCount; ++node)
+        {
+            for (uint64_t k = forward.offsets[node]; k < forward.offsets[node + 1]; ++k)
+            {
+                uint64_t slot = fill[forward.targets[k]]++;
+                backward.targets[slot] = node;
+                backward.weights[slot] = forward.weights[k];
+            }
+        }
+
+        // A path total (or the two halves of one) sums fewer than 2 x nodeCount weights. If that
+        // could exceed the largest double, every weight is halved until it cannot; halving is exact.
+        double heaviest = forward.weights.empty() ? 0 : *max_element(forward.weights.begin(), forward.weights.end());
+        double limit = numeric_limits<double>::max() / (2.0 * max<size_t>(1, nodeCount));
+        while (heaviest * adjacency->scale > limit)
+        {
+            adjacency->scale /= 2;
+        }
+        if (adjacency->scale != 1)
+        {
+            for (double &weight : forward.weights)
+            {
+                weight *= adjacency->scale;
+            }
+            for (double &weight : backward.weights)
+            {
+                weight *= adjacency->scale;
+            }
+        }
+
+        weightCache[key] = {version, adjacency};
+        return adjacency;
+    }
+
+    // Finds the cheapest path from `from` to `to`, where each relationship costs the numeric value
+    // of its `weightKey` property. Relationships without such a (non-negative) value are not used.
+    // Bidirectional Dijkstra on the cached weight columns: one search runs forward from `from`, the
+    // other backward from `to`, each with a 4-ary heap, always advancing the one whose next node
+    // is closer. It stops once the two closest unsettled nodes together cost at least the best
+    // path found through a node both searches have reached.
+    void shortestPath(const string &from, const string &to, const string &weightKey)
+    {
+        NodeId source = lookupNode(from);
+        NodeId target = lookupNode(to);
+        if (source == InvalidNode || target == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << (source == InvalidNode ? from : to) << "\\\" does not exist.\"}" << endl;
+            return;
+        }
+        Symbol key = symbols.find(weightKey);
+        if (key == NoSymbol)
+        {
+            out << "{\"error\": \"No relationship has the property '" << weightKey << "'.\"}" << endl;
+            return;
+        }
+        shared_ptr<const WeightedAdjacency> adjacency = weightedAdjacency(key);
+
+        struct Entry
+        {
+            double distance;
+            NodeId node;
+            bool operator<(const Entry &other) const
+            {
+                return distance < other.distance;
+            }
+        };
+
+        // One search direction. The distance and parent arrays are kept per thread between
+        // queries; only the entries a query touched are reset afterwards.
+        struct Search
+        {
+            vector<double> distance;
+            vector<NodeId> parent, touched;
+            QuaternaryHeap<Entry> heap;
+
+            void reach(NodeId node, double cost, NodeId from)
+            {
+                if (distance[node] == numeric_limits<double>::infinity())
+                {
+                    touched.push_back(node);
+                }
+                distance[node] = cost;
+                parent[node] = from;
+                heap.push({cost, node});
+            }
+
+            void reset()
+            {
+                for (NodeId node : touched)
+                {
+                    distance[node] = numeric_limits<double>::infinity();
+                    parent[node] = InvalidNode;
+                }
+                touched.clear();
+                heap.clear();
+            }
+        };
+        static thread_local Search searches[2];
+        const double Unreached = numeric_limits<double>::infinity();
+        for (Search &search : searches)
+        {
+            if (search.distance.size() < nodeTable.size())
+            {
+                search.distance.resize(nodeTable.size(), Unreached);
+                search.parent.resize(nodeTable.size(), InvalidNode);
+            }
+        }
+        Search &forward = searches[0];
+        Search &backward = searches[1];
+        forward.reach(source, 0, InvalidNode);
+        backward.reach(target, 0, InvalidNode);
+
+        double best = source == target ? 0 : Unreached;
+        NodeId meeting = source == target ? source : InvalidNode;
+        while (!forward.heap.empty() && !backward.heap.empty() &&
+               forward.heap.top().distance + backward.heap.top().distance < best)
+        {
+            bool goForward = forward.heap.top().distance <= backward.heap.top().distance;
+            Search &search = goForward ? forward : backward;
+            const Search &other = goForward ? backward : forward;
+            const WeightedAdjacency::Csr &csr = goForward ? adjacency->forward : adjacency->backward;
+
+            Entry entry = search.heap.top();
+            search.heap.pop();
+            if (entry.distance > search.distance[entry.node])
+            {
+                continue; // Stale entry; the node was reached more cheaply since
+            }
+            for (uint64_t k = csr.offsets[entry.node]; k < csr.offsets[entry.node + 1]; ++k)
+            {
+                NodeId next = csr.targets[k];
+                double candidate = entry.distance + csr.weights[k];
+                if (candidate < search.distance[next])
+                {
+                    search.reach(next, candidate, entry.node);
+                }
+                if (candidate + other.distance[next] < best)
+                {
+                    best = candidate + other.distance[next];
+                    meeting = next;
+                }
+            }
+        }
+
+        out << "{\"from\": \"" << from << "\", \"to\": \"" << to << "\", \"weight\": \"" << weightKey << "\", ";
+        if (meeting == InvalidNode)
+        {
+            out << "\"reachable\": false}" << endl;
+        }
+        else
+        {
+            // Source ... meeting from the forward parents, then meeting ... target from the backward ones
+            vector<NodeId> path;
+            for (NodeId node = meeting; node != InvalidNode; node = forward.parent[node])
+            {
+                path.push_back(node);
+            }
+            reverse(path.begin(), path.end());
+            for (NodeId node = backward.parent[meeting]; node != InvalidNode; node = backward.parent[node])
+            {
+                path.push_back(node);
+            }
+
+            // A cost beyond the largest double has no JSON number, so it is reported as null
+            double cost = best / adjacency->scale;
+            out << "\"reachable\": true, \"cost\": ";
+            if (std::isfinite(cost))
+            {
+                out << cost;
+            }
+            else
+            {
+                out << "null";
+            }
+            out << ", \"hops\": " << path.size() - 1 << ", \"path\": [";
+            for (size_t i = 0; i < path.size(); ++i)
+            {
+                out << (i ? ", " : "") << "\"" << nodeTable[path[i]]->name << "\"";
+            }
+            out << "]}" << endl;
+        }
+
+        forward.reset();
+        backward.reset();
+    }
+
+    // Tells whether `to` can be reached from `from` over at most `maxDepth` relationships (of the
+    // given types, or any type), and the length of the shortest such path. Searches from both
+    // ends at once, forward over outgoing and backward over incoming relationships, always growing
+    // the smaller frontier by one whole level, and stops at the first node both searches reach.
+    void pathExists(const string &from, const string &to, size_t maxDepth, const vector<string> &relations)
+    {
+        NodeId source = lookupNode(from);
+        NodeId target = lookupNode(to);
+        if (source == InvalidNode || target == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << (source == InvalidNode ? from : to) << "\\\" does not exist.\"}" << endl;
+            return;
+        }
+        vector<Symbol> relationSymbols;
+        for (const string &relation : relations)
+        {
+            relationSymbols.push_back(symbols.find(relation));
+        }
+
+        static thread_local VisitedSet forwardVisited, backwardVisited;
+        static thread_local vector<NodeId> forward, backward, next;
+        forwardVisited.reset(nodeTable.size());
+        backwardVisited.reset(nodeTable.size());
+        forwardVisited.insert(source);
+        backwardVisited.insert(target);
+        forward.assign(1, source);
+        backward.assign(1, target);
+
+        // Neither search has met the other after levels forwardDepth and backwardDepth, so the
+        // shortest path is longer than their sum; the first meeting gives its exact length
+        size_t forwardDepth = 0, backwardDepth = 0;
+        bool found = source == target;
+        while (!found && forwardDepth + backwardDepth < maxDepth && !forward.empty() && !backward.empty())
+        {
+            bool growForward = forward.size() <= backward.size();
+            vector<NodeId> &frontier = growForward ? forward : backward;
+            const vector<vector<Edge>> &adjacency = growForward ? relationships : incoming;
+            VisitedSet &visited = growForward ? forwardVisited : backwardVisited;
+            const VisitedSet &other = growForward ? backwardVisited : forwardVisited;
+
+            next.clear();
+            for (size_t i = 0; i < frontier.size() && !found; ++i)
+            {
+                for (const Edge &edge : adjacency[frontier[i]])
+                {
+                    if (!relationSymbols.empty() &&
+                        std::find(relationSymbols.begin(), relationSymbols.end(), edge.relationship->relation) == relationSymbols.end())
+                    {
+                        continue;
+                    }
+                    if (other.contains(edge.node))
+                    {
+                        found = true;
+                        break;
+                    }
+                    if (visited.insert(edge.node))
+                    {
+                        next.push_back(edge.node);
+                    }
+                }
+            }
+            frontier.swap(next);
+            ++(growForward ? forwardDepth : backwardDepth);
+        }
+
+        out << "{\"from\": \"" << from << "\", \"to\": \"" << to << "\", \"exists\": " << (found ? "true" : "false");
+        if (found)
+        {
+            out << ", \"hops\": " << forwardDepth + backwardDepth;
+        }
+        out << "}" << endl;
+    }
+
+    // Lists every binding of the pattern's nodes to entities such that each node's label and
+    // property filters hold and each relationship exists with one of its types. A relationship is
+    // used at most once per match; a variable named twice must bind the same entity both times.
+    //
+    // Planning: each node is expected to fit (label size) x (bucket size / entities for an indexed
+    // filter, 1/10 for any other filter) entities, and each relationship to lead from a node to
+    // (relationships of its types / entities) others. For every possible starting node the bound
+    // part of the chain is grown one relationship at a time towards the side expected to yield
+    // fewer rows; the start whose plan produces the fewest intermediate rows in total wins.
+    // Execution then scans the start's candidates and extends each one depth-first along the plan.
+    //
+    // "$n" in a label, key, value or type is replaced by the n-th of `parameters`; for planning it
+    // counts as an average label, key, value or type, so the plan suits every set of values. `plan` may hold
+    // the plan of an earlier run; it is kept until a tenth of the graph has changed since, and is
+    // replaced by a new one otherwise.
+    void matchPattern(const MatchPattern &pattern, const vector<string_view> &parameters, shared_ptr<const MatchPlan> &plan)
+    {
+        struct NodeConstraint
+        {
+            Symbol label = NoSymbol; // NoSymbol = any label
+            vector<pair<Symbol, string>> properties;
+            size_t group = 0;         // Nodes naming the same variable share a group
+            double estimate = 0;      // Expected number of fitting entities
+            const unordered_set<Node *> *candidates = nullptr; // Smallest known superset, if any
+        };
+
+        size_t nodeCount = pattern.nodes.size();
+        double entities = max<double>(1, nodeIds.size());
+        const double UnindexedSelectivity = 0.1;
+        auto field = [&](string_view text)
+        {
+            string value;
+            substituteParameters(text, parameters, value);
+            return value;
+        };
+        // A prepared plan is shared by every set of parameter values, so whatever a parameter
+        // fills in is estimated from averages rather than from the values of this execution.
+        auto parameterized = [&](string_view text)
+        {
+            return !parameters.empty() && text.find('$') != string_view::npos;
+        };
+
+        // Resolve names to symbols. A label, key or value no entity has makes the pattern unsatisfiable.
+        bool satisfiable = true;
+        vector<NodeConstraint> constraints(nodeCount);
+        vector<string_view> groupNames;
+        for (size_t i = 0; i < nodeCount; ++i)
+        {
+            const MatchNodePattern &node = pattern.nodes[i];
+            NodeConstraint &constraint = constraints[i];
+
+            auto named = std::find(groupNames.begin(), groupNames.end(), node.variable);
+            constraint.group = named != groupNames.end() && !node.variable.empty() ? named - groupNames.begin() : groupNames.size();
+            if (constraint.group == groupNames.size())
+            {
+                groupNames.push_back(node.variable);
+            }
+
+            constraint.estimate = entities;
+            if (!node.label.empty())
+            {
+                constraint.label = symbols.find(field(node.label));
+                auto labelIt = labelIndex.find(constraint.label);
+                satisfiable = satisfiable && labelIt != labelIndex.end();
+                constraint.candidates = labelIt != labelIndex.end() ? &labelIt->second : nullptr;
+                constraint.estimate = constraint.candidates ? constraint.candidates->size() : 0;
+                if (parameterized(node.label))
+                {
+                    constraint.estimate = entities / max<size_t>(1, labelIndex.size());
+                }
+            }
+            for (const auto &filter : node.filters)
+            {
+                Symbol key = symbols.find(field(filter.first));
+                satisfiable = satisfiable && key != NoSymbol;
+                constraint.properties.emplace_back(key, field(filter.second));
+                if (key == NoSymbol || !propertyIndex.has(key) || parameterized(filter.first))
+                {
+                    constraint.estimate *= UnindexedSelectivity;
+                    continue;
+                }
+
+                // An indexed filter knows exactly which entities fit it
+                const unordered_set<Node *> *bucket = propertyIndex.find(key, constraint.properties.back().second);
+                satisfiable = satisfiable && bucket;
+                size_t bucketSize = bucket ? bucket->size() : 0;
+                constraint.estimate *= parameterized(filter.second) ? 1.0 / max<size_t>(1, propertyIndex.distinctValues(key))
+                                                                    : bucketSize / entities;
+                if (bucket && (!constraint.candidates || bucketSize < constraint.candidates->size()))
+                {
+                    constraint.candidates = bucket;
+                }
+            }
+        }
+
+        vector<vector<Symbol>> edgeRelations(pattern.edges.size());
+        vector<double> fanout(pattern.edges.size());
+        for (size_t e = 0; e < pattern.edges.size(); ++e)
+        {
+            size_t count = pattern.edges[e].relations.empty() ? edgeIndex.size() : 0;
+            for (string_view relation : pattern.edges[e].relations)
+            {
+                Symbol symbol = symbols.find(field(relation));
+                edgeRelations[e].push_back(symbol);
+                auto counted = relationCounts.find(symbol);
+                if (parameterized(relation))
+                {
+                    count += edgeIndex.size() / max<size_t>(1, relationCounts.size());
+                    continue;
+                }
+                count += counted != relationCounts.end() ? counted->second : 0;
+            }
+            fanout[e] = count / entities;
+        }
+
+        // Greedy expansion order from `start`; returns the total of expected intermediate rows
+        auto planFrom = [&](size_t start, vector<MatchStep> &steps)
+        {
+            steps.clear();
+            vector<bool> groupBound(groupNames.size());
+            groupBound[constraints[start].group] = true;
+            double rows = constraints[start].estimate, cost = rows;
+            auto rowsVia = [&](size_t edge, size_t target)
+            {
+                const NodeConstraint &constraint = constraints[target];
+                double selectivity = (groupBound[constraint.group] ? 1 : constraint.estimate) / entities;
+                return rows * fanout[edge] * selectivity;
+            };
+
+            size_t left = start, right = start;
+            while (right - left + 1 < nodeCount)
+            {
+                double leftRows = left > 0 ? rowsVia(left - 1, left - 1) : numeric_limits<double>::infinity();
+                double rightRows = right + 1 < nodeCount ? rowsVia(right, right + 1) : numeric_limits<double>::infinity();
+                if (leftRows < rightRows)
+                {
+                    rows = leftRows;
+                    steps.push_back({left - 1, left, left - 1, !pattern.edges[left - 1].pointsRight, rows});
+                    --left;
+                }
+                else
+                {
+                    rows = rightRows;
+                    steps.push_back({right, right, right + 1, pattern.edges[right].pointsRight, rows});
+                    ++right;
+                }
+                groupBound[constraints[steps.back().to].group] = true;
+                cost += rows;
+            }
+            return cost;
+        };
+
+        size_t graphSize = nodeIds.size() + edgeIndex.size();
+        if (!plan || version - plan->version > plan->graphSize / 10)
+        {
+            auto chosen = make_shared<MatchPlan>();
+            vector<MatchStep> candidate;
+            double bestCost = numeric_limits<double>::infinity();
+            for (size_t i = 0; i < nodeCount; ++i)
+            {
+                double cost = planFrom(i, candidate);
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    chosen->start = i;
+                    chosen->steps.swap(candidate);
+                }
+            }
+            chosen->startRows = constraints[chosen->start].estimate;
+            chosen->version = version;
+            chosen->graphSize = graphSize;
+            plan = move(chosen);
+        }
+        size_t start = plan->start;
+        const vector<MatchStep> &steps = plan->steps;
+
+        auto nodeText = [&](size_t i)
+        {
+            return "(" + (pattern.nodes[i].variable.empty() ? "#" + to_string(i + 1) : string(pattern.nodes[i].variable)) + ")";
+        };
+        auto rowText = [](double rows)
+        {
+            return rows >= 1 ? "~" + to_string(static_cast<uint64_t>(rows + 0.5)) : rows > 0 ? string("<1") : string("0");
+        };
+
+        out << "{" << endl;
+        out << "  \"plan\": [\"scan " << nodeText(start) << " " << rowText(plan->startRows) << "\"";
+        for (const MatchStep &step : steps)
+        {
+            string types;
+            for (string_view relation : pattern.edges[step.edge].relations)
+            {
+                types += (types.empty() ? "" : "|") + string(relation);
+            }
+            out << ", \"" << nodeText(step.from) << (step.outgoing ? " -[" : " <-[") << types
+                << (step.outgoing ? "]-> " : "]- ") << nodeText(step.to) << " " << rowText(step.rows) << "\"";
+        }
+        out << "]," << endl;
+
+        out << "  \"columns\": [";
+        vector<size_t> columnGroups;
+        for (size_t group = 0; group < groupNames.size(); ++group)
+        {
+            if (!groupNames[group].empty())
+            {
+                out << (columnGroups.empty() ? "\"" : ", \"") << groupNames[group] << "\"";
+                columnGroups.push_back(group);
+            }
+        }
+        out << "]," << endl;
+        out << "  \"matches\": [";
+
+        vector<NodeId> groupNode(groupNames.size(), InvalidNode);
+        vector<size_t> groupUses(groupNames.size());
+        vector<Relationship *> usedRelationships;
+        size_t matches = 0;
+
+        auto fits = [&](size_t position, const Node *node)
+        {
+            const NodeConstraint &constraint = constraints[position];
+            if (constraint.label != NoSymbol && node->label != constraint.label)
+            {
+                return false;
+            }
+            for (const auto &property : constraint.properties)
+            {
+                auto it = node->properties.find(property.first);
+                if (it == node->properties.end() || it->second.text != property.second)
+                {
+                    return false;
+                }
+            }
+            NodeId bound = groupNode[constraint.group];
+            return bound == InvalidNode || bound == node->id;
+        };
+        auto bind = [&](size_t position, NodeId id)
+        {
+            size_t group = constraints[position].group;
+            groupNode[group] = id;
+            ++groupUses[group];
+        };
+        auto unbind = [&](size_t position)
+        {
+            size_t group = constraints[position].group;
+            if (--groupUses[group] == 0)
+            {
+                groupNode[group] = InvalidNode;
+            }
+        };
+
+        // Binds the remaining steps depth-first; returns false once the limit is reached
+        auto extend = [&](auto &self, size_t stepIndex) -> bool
+        {
+            if (stepIndex == steps.size())
+            {
+                out << (matches ? ",\n" : "\n") << "    [";
+                for (size_t c = 0; c < columnGroups.size(); ++c)
+                {
+                    out << (c ? ", \"" : "\"") << nodeTable[groupNode[columnGroups[c]]]->name << "\"";
+                }
+                out << "]";
+                return ++matches < pattern.limit;
+            }
+
+            const MatchStep &step = steps[stepIndex];
+            const vector<Symbol> &relations = edgeRelations[step.edge];
+            NodeId from = groupNode[constraints[step.from].group];
+            for (const Edge &edge : (step.outgoing ? relationships : incoming)[from])
+            {
+                if ((!relations.empty() && std::find(relations.begin(), relations.end(), edge.relationship->relation) == relations.end()) ||
+                    std::find(usedRelationships.begin(), usedRelationships.end(), edge.relationship) != usedRelationships.end() ||
+                    !fits(step.to, nodeTable[edge.node]))
+                {
+                    continue;
+                }
+                bind(step.to, edge.node);
+                usedRelationships.push_back(edge.relationship);
+                bool more = self(self, stepIndex + 1);
+                usedRelationships.pop_back();
+                unbind(step.to);
+                if (!more)
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+        auto tryStart = [&](const Node *node)
+        {
+            if (!fits(start, node))
+            {
+                return true;
+            }
+            bind(start, node->id);
+            bool more = extend(extend, 0);
+            unbind(start);
+            return more;
+        };
+
+        if (satisfiable && pattern.limit > 0)
+        {
+            if (constraints[start].candidates)
+            {
+                for (const Node *node : *constraints[start].candidates)
+                {
+                    if (!tryStart(node))
+                    {
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                for (const Node *node : nodeTable)
+                {
+                    if (node && !tryStart(node))
+                    {
+                        break;
+                    }
+                }
+            }
+        }
+        out << (matches ? "\n  ]," : "],") << endl;
+        out << "  \"count\": " << matches << endl;
+        out << "}" << endl;
+    }
+
+    void deleteNode(const string &label, const string &name)
+    {
+        // Step 1: Check if the node exists in the graph under the given label
+        NodeId id = lookupNode(name);
+        if (id == InvalidNode || nodeTable[id]->label != symbols.find(label))
+        {
+            out << "{\"error\": \"Node with name \"" << name << "\" not found.\"}" << endl;
+            return;
+        }
+        Node *node = nodeTable[id];
+
+        // Step 2: Remove all outgoing relationships from this node
+        // (this also removes self-relationships from the incoming list)
+        while (!relationships[id].empty())
+        {
+            Relationship *relationship = relationships[id].back().relationship;
+            unlinkRelationship(relationship);
+            relationshipPool.destroy(relationship); // Return the Relationship's slot to the pool
+        }
+
+        // Step 3: Remove all incoming relationships to this node using the reverse index
+        while (!incoming[id].empty())
+        {
+            Relationship *relationship = incoming[id].back().relationship;
+            unlinkRelationship(relationship);
+            relationshipPool.destroy(relationship); // Return the Relationship's slot to the pool
+        }
+        vector<Edge>().swap(relationships[id]); // Release the adjacency storage of the slot
+        vector<Edge>().swap(incoming[id]);
+
+        // Step 4: Remove the node from labelIndex (under the label it was created with)
+        auto labelIt = labelIndex.find(node->label);
+        if (labelIt != labelIndex.end())
+        {
+            labelIt->second.erase(node); // Remove the node pointer from its label set
+
+            // If no nodes remain with this label, erase the label itself
+            if (labelIt->second.empty())
+            {
+                labelIndex.erase(labelIt);
+            }
+        }
+
+        // Step 5: Remove the node from the property indexes, then free its slot and delete it
+        propertyIndex.removeAll(node);
+        if (LabelTable *table = labelTableOf(node))
+        {
+            table->removeRow(node);
+        }
+        nodeIds.erase(node->name);
+        nodeTable[id] = nullptr;
+        freeIds.push_back(id);
+        nodePool.destroy(node); // Return the Node's slot to the pool
+
+        // JSON feedback indicating successful deletion
+        out << "{\"status\": \"success\", \"message\": \"Node \"" << name << "\" and all associated relationships removed successfully.\"}" << endl;
+    }
+
+    void deleteRelation(const string &name1, const string &name2, const string &relationType = "ALL")
+    {
+        // Check if both nodes exist in the graph and if a relationship from name1 to name2 exists
+        NodeId from = lookupNode(name1);
+        if (from == InvalidNode || relationships[from].empty())
+        {
+            out << "{\"error\": \"Node \"" << name1 << "\" not found.\"}" << endl;
+            return;
+        }
+
+        // Look the relationship up directly and check if the type matches or if "ALL" is specified
+        NodeId to = lookupNode(name2);
+        Relationship *rel = to != InvalidNode ? findRelationship(from, to) : nullptr;
+        bool relationshipFound = rel && (relationType == "ALL" || rel->relation == symbols.find(relationType));
+
+        if (relationshipFound)
+        {
+            // Clear relationship properties
+            rel->properties.clear();
+
+            // Remove the relationship from both adjacency lists and the edge index
+            unlinkRelationship(rel);
+
+            // Delete the relationship itself
+            relationshipPool.destroy(rel);
+        }
+
+        // If no relationship was found, print a message
+        if (!relationshipFound)
+        {
+            out << "{\"error\": \"No matching relationship of type \"" << relationType
+                << "\" found between \"" << name1 << "\" and \"" << name2 << "\".}" << endl;
+            return;
+        }
+
+        // Feedback for successful deletion
+        out << "{\"status\": \"success\", \"message\": \"Relationship(s) between \""
+            << name1 << "\" and \"" << name2 << "\" of type \""
+            << relationType << "\" deleted successfully.\"}" << endl;
+    }
+
+    void createPropertyIndex(const vector<string> &keys)
+    {
+        for (const string &key : keys)
+        {
+            if (propertyIndex.createIndex(symbols.intern(key), nodeTable))
+            {
+                out << "{\"status\": \"success\", \"message\": \"Index on property '" << key << "' created.\"}" << endl;
+            }
+            else
+            {
+                out << "{\"warning\": \"Property '" << key << "' is already indexed.\"}" << endl;
+            }
+        }
+    }
+
+    void createRangeIndex(const vector<string> &keys)
+    {
+        for (const string &key : keys)
+        {
+            if (propertyIndex.createRangeIndex(symbols.intern(key), nodeTable))
+            {
+                out << "{\"status\": \"success\", \"message\": \"Range index on property '" << key << "' created.\"}" << endl;
+            }
+            else
+            {
+                out << "{\"warning\": \"Property '" << key << "' already has a range index.\"}" << endl;
+            }
+        }
+    }
+
+    // Stores the given property keys of every entity with `label` in columns for SCAN
+    void createColumns(const string &label, const vector<string> &keys)
+    {
+        Symbol labelSymbol = symbols.intern(label);
+        auto inserted = labelTables.try_emplace(labelSymbol);
+        LabelTable &table = inserted.first->second;
+        if (inserted.second)
+        {
+            auto labelIt = labelIndex.find(labelSymbol);
+            if (labelIt != labelIndex.end())
+            {
+                // Rows in node id order, so a scan's results come out in a stable order
+                vector<Node *> members(labelIt->second.begin(), labelIt->second.end());
+                sort(members.begin(), members.end(), [](const Node *a, const Node *b)
+                     { return a->id < b->id; });
+                table.rows.reserve(members.size());
+                for (Node *node : members)
+                {
+                    table.addRow(node);
+                }
+            }
+        }
+
+        for (const string &key : keys)
+        {
+            if (table.addColumn(symbols.intern(key)))
+            {
+                out << "{\"status\": \"success\", \"message\": \"Column '" << key << "' for label '" << label << "' created.\"}" << endl;
+            }
+            else
+            {
+                out << "{\"warning\": \"Label '" << label << "' already has a column for '" << key << "'.\"}" << endl;
+            }
+        }
+    }
+
+    // Lists the entities of `label` that satisfy every predicate. Numeric comparisons on keys with
+    // a column (CREATE_COLUMNS) are evaluated over the column for all rows at once, except on rows
+    // whose number the column cannot hold exactly; any other predicate is checked on the entities
+    // that are left.
+    void scanLabel(const string &label, const vector<PropertyPredicate> &predicates)
+    {
+        auto started = chrono::steady_clock::now();
+        Symbol labelSymbol = symbols.find(label);
+        auto labelIt = labelIndex.find(labelSymbol);
+        auto tableIt = labelTables.find(labelSymbol);
+        LabelTable *table = tableIt != labelTables.end() ? &tableIt->second : nullptr;
+
+        vector<pair<const PropertyPredicate *, Symbol>> rowChecks; // (predicate, key) checked per entity
+        vector<pair<const PropertyPredicate *, Symbol>> inexactChecks; // Columnar, checked on inexact rows
+        vector<const LabelTable::Column *> inexactColumns;
+        bool possible = labelIt != labelIndex.end();
+        size_t columnar = 0;
+        vector<uint64_t> selected;
+        if (table)
+        {
+            size_t rowCount = table->rows.size();
+            selected.assign((rowCount + 63) / 64, ~uint64_t(0));
+            if (rowCount % 64)
+            {
+                selected.back() = (uint64_t(1) << (rowCount % 64)) - 1;
+            }
+        }
+        for (const PropertyPredicate &predicate : predicates)
+        {
+            Symbol key = symbols.find(predicate.key);
+            possible = possible && key != NoSymbol;
+            auto column = table ? table->columns.find(key) : unordered_map<Symbol, LabelTable::Column>::iterator();
+            bool numeric = !predicate.equality && (!predicate.hasLower || LabelTable::holds(predicate.lower)) &&
+                           (!predicate.hasUpper || LabelTable::holds(predicate.upper));
+            if (!possible || !table || column == table->columns.end() || !numeric)
+            {
+                rowChecks.emplace_back(&predicate, key);
+                continue;
+            }
+
+            // Strict bounds become the next representable double, so the kernel only needs <= and >=
+            const double Infinity = numeric_limits<double>::infinity();
+            double lower = predicate.hasLower ? predicate.lower.number() : -Infinity;
+            double upper = predicate.hasUpper ? predicate.upper.number() : Infinity;
+            lower = predicate.hasLower && !predicate.lowerInclusive ? nextafter(lower, Infinity) : lower;
+            upper = predicate.hasUpper && !predicate.upperInclusive ? nextafter(upper, -Infinity) : upper;
+            LabelTable::filter(column->second, lower, upper, selected);
+            inexactChecks.emplace_back(&predicate, key);
+            inexactColumns.push_back(&column->second);
+            ++columnar;
+        }
+
+        auto passes = [](const Node *node, const pair<const PropertyPredicate *, Symbol> &check)
+        {
+            auto it = node->properties.find(check.second);
+            return it != node->properties.end() && check.first->matches(it->second);
+        };
+        auto satisfies = [&](const Node *node)
+        {
+            for (const auto &check : rowChecks)
+            {
+                if (!passes(node, check))
+                {
+                    return false;
+                }
+            }
+            for (size_t c = 0; c < inexactChecks.size(); ++c)
+            {
+                size_t r = node->labelSlot;
+                if ((inexactColumns[c]->inexact[r / 64] >> (r % 64)) & 1 && !passes(node, inexactChecks[c]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        vector<const Node *> matches;
+        if (possible && table)
+        {
+            for (size_t word = 0; word < selected.size(); ++word)
+            {
+                for (uint64_t bits = selected[word]; bits; bits &= bits - 1)
+                {
+                    const Node *node = table->rows[word * 64 + lowestBit(bits)];
+                    if (satisfies(node))
+                    {
+                        matches.push_back(node);
+                    }
+                }
+            }
+        }
+        else if (possible)
+        {
+            for (const Node *node : labelIt->second)
+            {
+                if (satisfies(node))
+                {
+                    matches.push_back(node);
+                }
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+        out << "{" << endl;
+        out << "  \"label\": \"" << label << "\"," << endl;
+        out << "  \"entities\": [";
+        for (size_t i = 0; i < matches.size(); ++i)
+        {
+            out << (i ? ",\n" : "\n") << "    \"" << matches[i]->name << "\"";
+        }
+        out << (matches.empty() ? "]," : "\n  ],") << endl;
+        out << "  \"count\": " << matches.size() << "," << endl;
+        out << "  \"columnar_predicates\": " << columnar << "," << endl;
+        out << "  \"microseconds\": " << static_cast<uint64_t>(seconds * 1e6) << endl;
+        out << "}" << endl;
+    }
+
+    // Runs body(0) ... body(chunks - 1) on the worker pool if there is one, else on this thread
+    void runChunks(size_t chunks, const function<void(size_t)> &body)
+    {
+        if (workers && chunks > 1)
+        {
+            workers->parallelFor(chunks, body);
+            return;
+        }
+        for (size_t chunk = 0; chunk < chunks; ++chunk)
+        {
+            body(chunk);
+        }
+    }
+
+    // Computes AGG{Label,FUNCTION(Key)...,GROUP_BY(Key)}: the aggregates over the entities of
+    // `label`, per distinct value of `groupKey` unless it is empty. Numeric keys with a column
+    // (CREATE_COLUMNS) are read from the column instead of each entity's properties. Labels
+    // larger than one chunk are split into chunks that run on the worker pool, each collecting
+    // its own groups, and the groups are merged at the end.
+    void aggregate(const string &label, const vector<AggregateSpec> &specs, const string &groupKey)
+    {
+        auto started = chrono::steady_clock::now();
+        Symbol labelSymbol = symbols.find(label);
+        auto tableIt = labelTables.find(labelSymbol);
+        const LabelTable *table = tableIt != labelTables.end() ? &tableIt->second : nullptr;
+
+        // The rows to aggregate: the label table's if there is one, else the label's members
+        vector<Node *> members;
+        auto labelIt = labelIndex.find(labelSymbol);
+        if (!table && labelIt != labelIndex.end())
+        {
+            members.assign(labelIt->second.begin(), labelIt->second.end());
+        }
+        const vector<Node *> &rows = table ? table->rows : members;
+
+        vector<Symbol> keys(specs.size(), NoSymbol);
+        vector<const LabelTable::Column *> columns(specs.size(), nullptr);
+        for (size_t a = 0; a < specs.size(); ++a)
+        {
+            keys[a] = specs[a].key.empty() ? NoSymbol : symbols.find(specs[a].key);
+            auto column = table ? table->columns.find(keys[a]) : unordered_map<Symbol, LabelTable::Column>::const_iterator();
+            // A column only holds numbers, so COUNT (which counts any value) reads the entities
+            if (table && column != table->columns.end() && specs[a].function != AggregateFunction::Count)
+            {
+                columns[a] = &column->second;
+            }
+        }
+        Symbol groupSymbol = groupKey.empty() ? NoSymbol : symbols.find(groupKey);
+
+        struct Group
+        {
+            const PropertyValue *value = nullptr; // nullptr: the entities without the group key
+            vector<AggregateState> states;
+        };
+        struct Partial
+        {
+            vector<Group> groups;
+            unordered_map<string_view, size_t> byValue; // Group value text -> index in groups
+            size_t missing = SIZE_MAX;                  // Index of the group without a value
+        };
+        auto groupOf = [&](Partial &partial, const PropertyValue *value) -> vector<AggregateState> &
+        {
+            size_t &index = value ? partial.byValue.try_emplace(value->text, SIZE_MAX).first->second : partial.missing;
+            if (index == SIZE_MAX)
+            {
+                index = partial.groups.size();
+                partial.groups.push_back({value, vector<AggregateState>(specs.size())});
+            }
+            return partial.groups[index].states;
+        };
+        auto valueOf = [](const Node *node, Symbol key) -> const PropertyValue *
+        {
+            auto it = node->properties.find(key);
+            return it != node->properties.end() ? &it->second : nullptr;
+        };
+
+        // Chunks are a multiple of 64 rows, so no two chunks share a word of a presence bitmap
+        const size_t ChunkRows = 1 << 16;
+        size_t rowCount = rows.size();
+        size_t chunkCount = (rowCount + ChunkRows - 1) / ChunkRows;
+        vector<Partial> partials(chunkCount);
+        auto runChunk = [&](size_t chunk)
+        {
+            Partial &partial = partials[chunk];
+            size_t begin = chunk * ChunkRows, end = min(rowCount, begin + ChunkRows);
+            if (groupKey.empty())
+            {
+                // One group: each aggregate is a loop of its own over the rows
+                vector<AggregateState> &states = groupOf(partial, nullptr);
+                for (size_t a = 0; a < specs.size(); ++a)
+                {
+                    AggregateState &state = states[a];
+                    if (columns[a])
+                    {
+                        // The int64 total wraps freely: it is exact whenever the true total fits,
+                        // which the double total (far from 2^63) vouches for
+                        const double *values = columns[a]->values.data();
+                        const uint64_t *present = columns[a]->present.data();
+                        AggregateState chunkState;
+                        bool whole = true;
+                        uint64_t integerSum = 0;
+                        for (size_t r = begin; r < end; ++r)
+                        {
+                            bool has = (present[r / 64] >> (r % 64)) & 1;
+                            double value = values[r];
+                            int64_t integer = static_cast<int64_t>(fabs(value) <= AggregateState::Exact ? value : 0);
+                            bool isWhole = fabs(value) <= AggregateState::Exact && static_cast<double>(integer) == value;
+                            chunkState.count += has;
+                            chunkState.sum += has ? value : 0.0;
+                            chunkState.lowest = has && value < chunkState.lowest ? value : chunkState.lowest;
+                            chunkState.highest = has && value > chunkState.highest ? value : chunkState.highest;
+                            whole = whole && (!has || isWhole);
+                            integerSum += has ? static_cast<uint64_t>(integer) : 0;
+                            chunkState.integerLowest = has && integer < chunkState.integerLowest ? integer : chunkState.integerLowest;
+                            chunkState.integerHighest = has && integer > chunkState.integerHighest ? integer : chunkState.integerHighest;
+                        }
+                        chunkState.whole = whole;
+                        chunkState.exactSum = whole && fabs(chunkState.sum) < 0x1p62;
+                        chunkState.integerSum = static_cast<int64_t>(integerSum);
+                        state.merge(chunkState);
+                        // Numbers the column cannot hold exactly are read from their entities
+                        const uint64_t *inexact = columns[a]->inexact.data();
+                        for (size_t word = begin / 64; word * 64 < end; ++word)
+                        {
+                            for (uint64_t bits = inexact[word]; bits; bits &= bits - 1)
+                            {
+                                state.add(*valueOf(rows[word * 64 + lowestBit(bits)], keys[a]));
+                            }
+                        }
+                    }
+                    else if (keys[a] == NoSymbol)
+                    {
+                        state.count += specs[a].key.empty() ? end - begin : 0; // COUNT(*), or a key nobody has
+                    }
+                    else
+                    {
+                        for (size_t r = begin; r < end; ++r)
+                        {
+                            const PropertyValue *value = valueOf(rows[r], keys[a]);
+                            if (value && specs[a].function == AggregateFunction::Count)
+                            {
+                                ++state.count;
+                            }
+                            else if (value && value->isNumber())
+                            {
+                                state.add(*value);
+                            }
+                        }
+                    }
+                }
+                return;
+            }
+
+            for (size_t r = begin; r < end; ++r)
+            {
+                vector<AggregateState> &states = groupOf(partial, valueOf(rows[r], groupSymbol));
+                for (size_t a = 0; a < specs.size(); ++a)
+                {
+                    if (columns[a])
+                    {
+                        if ((columns[a]->present[r / 64] >> (r % 64)) & 1)
+                        {
+                            states[a].add(columns[a]->values[r]);
+                        }
+                        else if ((columns[a]->inexact[r / 64] >> (r % 64)) & 1)
+                        {
+                            states[a].add(*valueOf(rows[r], keys[a]));
+                        }
+                        continue;
+                    }
+                    const PropertyValue *value = keys[a] == NoSymbol ? nullptr : valueOf(rows[r], keys[a]);
+                    if (specs[a].function == AggregateFunction::Count && (value || specs[a].key.empty()))
+                    {
+                        ++states[a].count;
+                    }
+                    else if (value && value->isNumber())
+                    {
+                        states[a].add(*value);
+                    }
+                }
+            }
+        };
+        runChunks(chunkCount, runChunk);
+
+        // Merge the chunks' groups, then order them by value with the entities lacking it last
+        Partial merged;
+        if (groupKey.empty())
+        {
+            groupOf(merged, nullptr); // Even an empty label has its one row of results
+        }
+        for (Partial &partial : partials)
+        {
+            for (Group &group : partial.groups)
+            {
+                vector<AggregateState> &states = groupOf(merged, group.value);
+                for (size_t a = 0; a < specs.size(); ++a)
+                {
+                    states[a].merge(group.states[a]);
+                }
+            }
+        }
+        vector<Group> &groups = merged.groups;
+        sort(groups.begin(), groups.end(), [](const Group &a, const Group &b)
+             {
+                 if (!a.value || !b.value)
+                 {
+                     return a.value && !b.value;
+                 }
+                 int order = compareValues(*a.value, *b.value);
+                 return order != 0 ? order < 0 : a.value->text < b.value->text; });
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+        // Whole results print without a fraction, so sums of whole numbers read as such
+        auto printNumber = [](double value)
+        {
+            if (value == floor(value) && fabs(value) < 9e15)
+            {
+                out << static_cast<int64_t>(value);
+            }
+            else
+            {
+                out << value;
+            }
+        };
+        out << "{" << endl;
+        out << "  \"label\": \"" << label << "\"," << endl;
+        out << "  \"columns\": [";
+        if (!groupKey.empty())
+        {
+            out << "\"" << groupKey << "\"" << (specs.empty() ? "" : ", ");
+        }
+        for (size_t a = 0; a < specs.size(); ++a)
+        {
+            out << (a ? ", " : "") << "\"" << specs[a].text << "\"";
+        }
+        out << "]," << endl;
+        out << "  \"rows\": [";
+        for (size_t g = 0; g < groups.size(); ++g)
+        {
+            out << (g ? ",\n" : "\n") << "    [";
+            if (!groupKey.empty())
+            {
+                if (groups[g].value)
+                {
+                    out << "\"" << groups[g].value->text << "\"";
+                }
+                else
+                {
+                    out << "null";
+                }
+                out << (specs.empty() ? "" : ", ");
+            }
+            for (size_t a = 0; a < specs.size(); ++a)
+            {
+                const AggregateState &state = groups[g].states[a];
+                out << (a ? ", " : "");
+                if (specs[a].function == AggregateFunction::Count)
+                {
+                    out << state.count;
+                }
+                else if (state.count == 0)
+                {
+                    out << "null";
+                }
+                else if (specs[a].function == AggregateFunction::Average)
+                {
+                    out << (state.exactSum ? static_cast<double>(state.integerSum) : state.sum) / state.count;
+                }
+                else if (specs[a].function == AggregateFunction::Sum && state.exactSum)
+                {
+                    out << state.integerSum;
+                }
+                else if (specs[a].function != AggregateFunction::Sum && state.whole)
+                {
+                    out << (specs[a].function == AggregateFunction::Minimum ? state.integerLowest : state.integerHighest);
+                }
+                else
+                {
+                    printNumber(specs[a].function == AggregateFunction::Sum ? state.sum : specs[a].function == AggregateFunction::Minimum ? state.lowest
+                                                                                                                                         : state.highest);
+                }
+            }
+            out << "]";
+        }
+        out << (groups.empty() ? "]," : "\n  ],") << endl;
+        out << "  \"entities\": " << rowCount << "," << endl;
+        out << "  \"microseconds\": " << static_cast<uint64_t>(seconds * 1e6) << endl;
+        out << "}" << endl;
+    }
+
+    // Computes COUNT{...}: the entities of a label, or the relationships of the given types
+    // between entities of the source and target labels together with how many source entities
+    // have at least one. Large sources are counted in chunks on the worker pool.
+    void countPattern(const string &text, const CountPattern &pattern)
+    {
+        auto started = chrono::steady_clock::now();
+        auto membersOf = [&](const string &label) -> const unordered_set<Node *> *
+        {
+            auto it = labelIndex.find(symbols.find(label));
+            return it != labelIndex.end() ? &it->second : nullptr;
+        };
+
+        size_t entities = 0, matched = 0;
+        if (!pattern.hasRelationship)
+        {
+            const unordered_set<Node *> *members = membersOf(pattern.source);
+            entities = pattern.source == "*" ? nodeIds.size() : members ? members->size() : 0;
+        }
+        else
+        {
+            // Source entities by id, a relation filter (empty: any type) and a target label filter
+            vector<NodeId> sources;
+            if (pattern.source == "*")
+            {
+                sources.reserve(nodeIds.size());
+                for (NodeId id = 0; id < nodeTable.size(); ++id)
+                {
+                    if (nodeTable[id])
+                    {
+                        sources.push_back(id);
+                    }
+                }
+            }
+            else if (const unordered_set<Node *> *members = membersOf(pattern.source))
+            {
+                sources.reserve(members->size());
+                for (const Node *node : *members)
+                {
+                    sources.push_back(node->id);
+                }
+            }
+            vector<Symbol> relations;
+            for (const string &relation : pattern.relations)
+            {
+                relations.push_back(symbols.find(relation));
+            }
+            bool anyTarget = pattern.target == "*";
+            Symbol targetLabel = anyTarget ? NoSymbol : symbols.find(pattern.target);
+            const vector<vector<Edge>> &adjacency = pattern.outgoing ? relationships : incoming;
+
+            const size_t ChunkNodes = 1 << 14;
+            size_t chunkCount = (sources.size() + ChunkNodes - 1) / ChunkNodes;
+            vector<pair<size_t, size_t>> counts(chunkCount); // (relationships, entities) per chunk
+            auto runChunk = [&](size_t chunk)
+            {
+                size_t begin = chunk * ChunkNodes, end = min(sources.size(), begin + ChunkNodes);
+                for (size_t i = begin; i < end; ++i)
+                {
+                    size_t found = 0;
+                    for (const Edge &edge : adjacency[sources[i]])
+                    {
+                        bool typed = relations.empty() || find(relations.begin(), relations.end(), edge.relationship->relation) != relations.end();
+                        found += typed && (anyTarget || nodeTable[edge.node]->label == targetLabel);
+                    }
+                    counts[chunk].first += found;
+                    counts[chunk].second += found != 0;
+                }
+            };
+            runChunks(chunkCount, runChunk);
+            for (const auto &count : counts)
+            {
+                matched += count.first;
+                entities += count.second;
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+        out << "{\"pattern\": \"" << text << "\", \"entities\": " << entities;
+        if (pattern.hasRelationship)
+        {
+            out << ", \"relationships\": " << matched;
+        }
+        out << ", \"microseconds\": " << static_cast<uint64_t>(seconds * 1e6) << "}" << endl;
+    }
+
+    // Builds the transposed CSR of the relationships of the given types (any type if none) from
+    // the adjacency lists. Both passes run over chunks of nodes on the worker pool: one counts
+    // each node's relationships, and after a prefix sum over the counts the other fills in the
+    // sources.
+    RankAdjacency rankAdjacency(const vector<Symbol> &relationSymbols)
+    {
+        auto followed = [&](const Edge &edge)
+        {
+            return relationSymbols.empty() ||
+                   std::find(relationSymbols.begin(), relationSymbols.end(), edge.relationship->relation) != relationSymbols.end();
+        };
+        size_t nodeCount = nodeTable.size();
+        const size_t ChunkNodes = 1 << 14;
+        size_t chunkCount = (nodeCount + ChunkNodes - 1) / ChunkNodes;
+
+        RankAdjacency adjacency;
+        adjacency.offsets.assign(nodeCount + 1, 0);
+        adjacency.outDegree.assign(nodeCount, 0);
+        runChunks(chunkCount, [&](size_t chunk)
+                  {
+            for (NodeId node = chunk * ChunkNodes; node < min(nodeCount, (chunk + 1) * ChunkNodes); ++node)
+            {
+                adjacency.offsets[node + 1] = count_if(incoming[node].begin(), incoming[node].end(), followed);
+                adjacency.outDegree[node] = count_if(relationships[node].begin(), relationships[node].end(), followed);
+            } });
+        partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+        adjacency.sources.resize(adjacency.offsets.back());
+        runChunks(chunkCount, [&](size_t chunk)
+                  {
+            for (NodeId node = chunk * ChunkNodes; node < min(nodeCount, (chunk + 1) * ChunkNodes); ++node)
+            {
+                uint64_t k = adjacency.offsets[node];
+                for (const Edge &edge : incoming[node])
+                {
+                    if (followed(edge))
+                    {
+                        adjacency.sources[k++] = edge.node;
+                    }
+                }
+            } });
+        return adjacency;
+    }
+
+    // PageRank over the relationships of the given types (any type if none), by NodeId (0 for free
+    // slots). Each round computes
+    //   rank(v) = (1 - damping) / N + damping * (dangling / N + sum of rank(u) / outDegree(u))
+    // over the sources u of v, where `dangling` is the rank held by entities with no outgoing
+    // relationship, spread evenly. Stops after `iterations` rounds or once the ranks move by less
+    // than 1e-9 in total; `rounds` and `delta` report how it ended. Every node's sum is taken in
+    // the same order whatever the thread count, so the scores do not depend on it.
+    vector<double> pageRank(const vector<Symbol> &relationSymbols, size_t iterations, double damping, size_t &rounds, double &delta, size_t &relationshipCount)
+    {
+        const double Tolerance = 1e-9;
+        RankAdjacency adjacency = rankAdjacency(relationSymbols);
+        relationshipCount = adjacency.sources.size();
+        size_t nodeCount = nodeTable.size();
+        double entities = nodeIds.size();
+
+        vector<double> rank(nodeCount, 0), next(nodeCount, 0), share(nodeCount, 0);
+        for (NodeId node = 0; node < nodeCount; ++node)
+        {
+            rank[node] = nodeTable[node] ? 1 / entities : 0;
+        }
+        const size_t ChunkNodes = 1 << 14;
+        size_t chunkCount = (nodeCount + ChunkNodes - 1) / ChunkNodes;
+        vector<double> chunkSums(chunkCount);
+
+        rounds = 0;
+        delta = 0;
+        while (rounds < iterations && nodeCount > 0)
+        {
+            // What each entity passes along each of its relationships, and the dangling rank
+            runChunks(chunkCount, [&](size_t chunk)
+                      {
+                double dangling = 0;
+                for (NodeId node = chunk * ChunkNodes; node < min(nodeCount, (chunk + 1) * ChunkNodes); ++node)
+                {
+                    uint32_t degree = adjacency.outDegree[node];
+                    share[node] = degree ? rank[node] / degree : 0;
+                    dangling += degree ? 0 : rank[node];
+                }
+                chunkSums[chunk] = dangling; });
+            double base = (1 - damping + damping * accumulate(chunkSums.begin(), chunkSums.end(), 0.0)) / entities;
+
+            runChunks(chunkCount, [&](size_t chunk)
+                      {
+                double change = 0;
+                for (NodeId node = chunk * ChunkNodes; node < min(nodeCount, (chunk + 1) * ChunkNodes); ++node)
+                {
+                    if (!nodeTable[node])
+                    {
+                        continue;
+                    }
+                    double sum = 0;
+                    for (uint64_t k = adjacency.offsets[node]; k < adjacency.offsets[node + 1]; ++k)
+                    {
+                        sum += share[adjacency.sources[k]];
+                    }
+                    next[node] = base + damping * sum;
+                    change += fabs(next[node] - rank[node]);
+                }
+                chunkSums[chunk] = change; });
+            rank.swap(next);
+            ++rounds;
+            delta = accumulate(chunkSums.begin(), chunkSums.end(), 0.0);
+            if (delta < Tolerance)
+            {
+                break;
+            }
+        }
+        return rank;
+    }
+
+    // The `top` live entities with the highest score, highest first (ties by id)
+    vector<NodeId> topEntities(const vector<double> &score, size_t top)
+    {
+        vector<NodeId> ids;
+        ids.reserve(nodeIds.size());
+        for (NodeId node = 0; node < nodeTable.size(); ++node)
+        {
+            if (nodeTable[node])
+            {
+                ids.push_back(node);
+            }
+        }
+        top = min(top, ids.size());
+        partial_sort(ids.begin(), ids.begin() + top, ids.end(), [&](NodeId a, NodeId b)
+                     { return score[a] != score[b] ? score[a] > score[b] : a < b; });
+        ids.resize(top);
+        return ids;
+    }
+
+    // PAGERANK{...}: lists the `top` entities by PageRank
+    void pageRankTop(const vector<Symbol> &relationSymbols, size_t iterations, double damping, size_t top)
+    {
+        auto started = chrono::steady_clock::now();
+        size_t rounds, relationshipCount;
+        double delta;
+        vector<double> rank = pageRank(relationSymbols, iterations, damping, rounds, delta, relationshipCount);
+        vector<NodeId> best = topEntities(rank, top);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+        out << "{" << endl;
+        out << "  \"entities\": " << nodeIds.size() << "," << endl;
+        out << "  \"relationships\": " << relationshipCount << "," << endl;
+        out << "  \"iterations\": " << rounds << "," << endl;
+        out << "  \"converged\": " << (delta < 1e-9 ? "true" : "false") << "," << endl;
+        out << "  \"top\": [";
+        for (size_t i = 0; i < best.size(); ++i)
+        {
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << nodeTable[best[i]]->name << "\", \"score\": " << rank[best[i]] << "}";
+        }
+        out << (best.empty() ? "]," : "\n  ],") << endl;
+        out << "  \"milliseconds\": " << static_cast<uint64_t>(seconds * 1000) << endl;
+        out << "}" << endl;
+    }
+
+    // PAGERANK_STORE{...}: stores every entity's PageRank as its property `key`
+    void storePageRank(const vector<Symbol> &relationSymbols, size_t iterations, double damping, const string &key)
+    {
+        size_t rounds, relationshipCount;
+        double delta;
+        vector<double> rank = pageRank(relationSymbols, iterations, damping, rounds, delta, relationshipCount);
+        Symbol keySymbol = symbols.intern(key);
+        char digits[32];
+        for (NodeId node = 0; node < nodeTable.size(); ++node)
+        {
+            if (nodeTable[node])
+            {
+                auto result = to_chars(digits, digits + sizeof(digits), rank[node]);
+                setNodeProperty(nodeTable[node], keySymbol, string(digits, result.ptr));
+            }
+        }
+        out << "{\"status\": \"success\", \"message\": \"PageRank of " << nodeIds.size() << " entities stored as '" << key
+            << "' after " << rounds << " iterations.\"}" << endl;
+    }
+
+    // DEGREE{...}: lists the `top` entities by number of relationships of the given types (any
+    // type if none), counting both directions
+    void degreeTop(const vector<Symbol> &relationSymbols, size_t top)
+    {
+        auto started = chrono::steady_clock::now();
+        RankAdjacency adjacency = rankAdjacency(relationSymbols);
+        size_t nodeCount = nodeTable.size();
+        vector<double> degree(nodeCount);
+        for (NodeId node = 0; node < nodeCount; ++node)
+        {
+            degree[node] = adjacency.offsets[node + 1] - adjacency.offsets[node] + adjacency.outDegree[node];
+        }
+        vector<NodeId> best = topEntities(degree, top);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+        out << "{" << endl;
+        out << "  \"entities\": " << nodeIds.size() << "," << endl;
+        out << "  \"relationships\": " << adjacency.sources.size() << "," << endl;
+        out << "  \"top\": [";
+        for (size_t i = 0; i < best.size(); ++i)
+        {
+            NodeId node = best[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << nodeTable[node]->name << "\", \"in\": "
+                << adjacency.offsets[node + 1] - adjacency.offsets[node] << ", \"out\": " << adjacency.outDegree[node] << "}";
+        }
+        out << (best.empty() ? "]," : "\n  ],") << endl;
+        out << "  \"milliseconds\": " << static_cast<uint64_t>(seconds * 1000) << endl;
+        out << "}" << endl;
+    }
+
+    // Brings `components` up to date after relationships were removed, by min-label propagation:
+    // every node starts with its own id as label and repeatedly takes the smallest label among
+    // its own, its label's and its neighbours' in either direction, until a pass over all nodes
+    // changes nothing; then every node holds the smallest id of its component. Passes run over
+    // chunks of nodes on the worker pool and update the labels in place, so a smaller label
+    // spreads within the same pass. Labels only ever decrease, which makes the relaxed atomic
+    // accesses safe whatever order threads see them in. Requires componentMutex.
+    void refreshComponents()
+    {
+        if (!components.isDirty())
+        {
+            return;
+        }
+        size_t nodeCount = nodeTable.size();
+        unique_ptr<atomic<NodeId>[]> labels(new atomic<NodeId>[nodeCount]);
+        for (NodeId node = 0; node < nodeCount; ++node)
+        {
+            labels[node].store(node, memory_order_relaxed);
+        }
+        auto labelOf = [&](NodeId node)
+        {
+            return labels[node].load(memory_order_relaxed);
+        };
+        const size_t ChunkNodes = 1 << 14;
+        size_t chunkCount = (nodeCount + ChunkNodes - 1) / ChunkNodes;
+        vector<char> chunkChanged(chunkCount);
+
+        bool changed = true;
+        while (changed)
+        {
+            runChunks(chunkCount, [&](size_t chunk)
+                      {
+                bool any = false;
+                for (NodeId node = chunk * ChunkNodes; node < min(nodeCount, (chunk + 1) * ChunkNodes); ++node)
+                {
+                    NodeId current = labelOf(node), label = labelOf(current);
+                    for (const Edge &edge : relationships[node])
+                    {
+                        label = min(label, labelOf(edge.node));
+                    }
+                    for (const Edge &edge : incoming[node])
+                    {
+                        label = min(label, labelOf(edge.node));
+                    }
+                    if (label < current)
+                    {
+                        labels[node].store(label, memory_order_relaxed);
+                        any = true;
+                    }
+                }
+                chunkChanged[chunk] = any; });
+            changed = find(chunkChanged.begin(), chunkChanged.end(), 1) != chunkChanged.end();
+        }
+
+        vector<NodeId> result(nodeCount);
+        for (NodeId node = 0; node < nodeCount; ++node)
+        {
+            result[node] = labelOf(node);
+        }
+        components.rebuild(move(result), [&](NodeId node)
+                           { return nodeTable[node] != nullptr; });
+    }
+
+    // COMPONENT_OF{Name}: the size of the entity's component and the name of its representative
+    // (the same for every entity of the component until the graph changes)
+    void componentOf(const string &name)
+    {
+        NodeId id = lookupNode(name);
+        if (id == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << name << "\\\" does not exist.\"}" << endl;
+            return;
+        }
+        lock_guard<mutex> lock(componentMutex);
+        refreshComponents();
+        out << "{\"name\": \"" << name << "\", \"component\": \"" << nodeTable[components.find(id)]->name
+            << "\", \"size\": " << components.sizeOf(id) << "}" << endl;
+    }
+
+    // SAME_COMPONENT{Name1,Name2}: whether a chain of relationships in any direction connects them
+    void sameComponent(const string &name1, const string &name2)
+    {
+        NodeId first = lookupNode(name1), second = lookupNode(name2);
+        if (first == InvalidNode || second == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << (first == InvalidNode ? name1 : name2) << "\\\" does not exist.\"}" << endl;
+            return;
+        }
+        lock_guard<mutex> lock(componentMutex);
+        refreshComponents();
+        out << "{\"from\": \"" << name1 << "\", \"to\": \"" << name2 << "\", \"same_component\": "
+            << (components.find(first) == components.find(second) ? "true" : "false") << "}" << endl;
+    }
+
+    // COMPONENTS{minSize}: every component of at least `minSize` entities, largest first
+    void listComponents(size_t minSize)
+    {
+        lock_guard<mutex> lock(componentMutex);
+        refreshComponents();
+        vector<pair<uint32_t, NodeId>> roots; // (size, root)
+        size_t total = 0;
+        for (NodeId node = 0; node < nodeTable.size(); ++node)
+        {
+            if (nodeTable[node] && components.find(node) == node)
+            {
+                ++total;
+                if (components.sizeOf(node) >= minSize)
+                {
+                    roots.emplace_back(components.sizeOf(node), node);
+                }
+            }
+        }
+        sort(roots.begin(), roots.end(), [](const pair<uint32_t, NodeId> &a, const pair<uint32_t, NodeId> &b)
+             { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+
+        out << "{" << endl;
+        out << "  \"entities\": " << nodeIds.size() << "," << endl;
+        out << "  \"components\": " << total << "," << endl;
+        out << "  \"listed\": [";
+        for (size_t i = 0; i < roots.size(); ++i)
+        {
+            out << (i ? ",\n" : "\n") << "    {\"component\": \"" << nodeTable[roots[i].second]->name << "\", \"size\": " << roots[i].first << "}";
+        }
+        out << (roots.empty() ? "]" : "\n  ]") << endl;
+        out << "}" << endl;
+    }
+
+    // Collects the neighbours of `node` over relationships of the given types (any type if none)
+    // in either direction, sorted by id, without duplicates and without the node itself
+    void sortedNeighbours(NodeId node, const vector<Symbol> &relationSymbols, vector<NodeId> &neighbours)
+    {
+        neighbours.clear();
+        for (const vector<vector<Edge>> *adjacency : {&relationships, &incoming})
+        {
+            for (const Edge &edge : (*adjacency)[node])
+            {
+                if (edge.node != node && (relationSymbols.empty() ||
+                                          std::find(relationSymbols.begin(), relationSymbols.end(), edge.relationship->relation) != relationSymbols.end()))
+                {
+                    neighbours.push_back(edge.node);
+                }
+            }
+        }
+        sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    }
+
+    // COMMON{Name1,Name2,...}: the entities related to both nodes, in either direction
+    void commonNeighbours(const string &name1, const string &name2, const vector<Symbol> &relationSymbols)
+    {
+        NodeId first = lookupNode(name1), second = lookupNode(name2);
+        if (first == InvalidNode || second == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << (first == InvalidNode ? name1 : name2) << "\\\" does not exist.\"}" << endl;
+            return;
+        }
+        vector<NodeId> firstNeighbours, secondNeighbours, common;
+        sortedNeighbours(first, relationSymbols, firstNeighbours);
+        sortedNeighbours(second, relationSymbols, secondNeighbours);
+        intersectSorted(firstNeighbours.data(), firstNeighbours.size(), secondNeighbours.data(), secondNeighbours.size(), [&](NodeId node)
+                        { common.push_back(node); });
+
+        out << "{" << endl;
+        out << "  \"from\": \"" << name1 << "\"," << endl;
+        out << "  \"to\": \"" << name2 << "\"," << endl;
+        out << "  \"common\": [";
+        for (size_t i = 0; i < common.size(); ++i)
+        {
+            out << (i ? ", " : "") << "\"" << nodeTable[common[i]]->name << "\"";
+        }
+        out << "]," << endl;
+        out << "  \"count\": " << common.size() << endl;
+        out << "}" << endl;
+    }
+
+    // TRIANGLES{Name,...}: the triangles through a node (pairs of its neighbours that are related
+    // themselves) and its local clustering coefficient, the share of such pairs among all pairs
+    void nodeTriangles(const string &name, const vector<Symbol> &relationSymbols)
+    {
+        NodeId node = lookupNode(name);
+        if (node == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << name << "\\\" does not exist.\"}" << endl;
+            return;
+        }
+        vector<NodeId> neighbours, around;
+        sortedNeighbours(node, relationSymbols, neighbours);
+        size_t links = 0; // Every triangle is seen from both of its other corners
+        for (NodeId neighbour : neighbours)
+        {
+            sortedNeighbours(neighbour, relationSymbols, around);
+            intersectSorted(neighbours.data(), neighbours.size(), around.data(), around.size(), [&](NodeId)
+                            { ++links; });
+        }
+        size_t degree = neighbours.size();
+        double clustering = degree < 2 ? 0 : double(links) / (double(degree) * (degree - 1));
+        out << "{\"name\": \"" << name << "\", \"neighbours\": " << degree << ", \"triangles\": " << links / 2
+            << ", \"clustering\": " << clustering << "}" << endl;
+    }
+
+    // TRIANGLES{*,...}: every triangle of the graph, counted once. The undirected adjacency is
+    // rebuilt as sorted id arrays and oriented from each node to its neighbours of higher degree
+    // (ties by id), so each triangle is found exactly once, from its lowest corner, and even a
+    // hub only intersects the short lists of its few higher-degree neighbours. Nodes are counted
+    // in chunks on the worker pool.
+    void countTriangles(const vector<Symbol> &relationSymbols)
+    {
+        auto started = chrono::steady_clock::now();
+        size_t nodeCount = nodeTable.size();
+        const size_t ChunkNodes = 1 << 12;
+        size_t chunkCount = (nodeCount + ChunkNodes - 1) / ChunkNodes;
+        auto chunkEnd = [&](size_t chunk)
+        {
+            return NodeId(min(nodeCount, (chunk + 1) * ChunkNodes));
+        };
+
+        // Pass 1: each node's sorted neighbours, in a CSR sized by its adjacency lists
+        vector<uint64_t> offsets(nodeCount + 1, 0);
+        for (NodeId node = 0; node < nodeCount; ++node)
+        {
+            offsets[node + 1] = offsets[node] + relationships[node].size() + incoming[node].size();
+        }
+        vector<NodeId> neighbours(offsets.back());
+        vector<uint32_t> degree(nodeCount);
+        runChunks(chunkCount, [&](size_t chunk)
+                  {
+            vector<NodeId> sorted;
+            for (NodeId node = chunk * ChunkNodes; node < chunkEnd(chunk); ++node)
+            {
+                sortedNeighbours(node, relationSymbols, sorted);
+                copy(sorted.begin(), sorted.end(), neighbours.begin() + offsets[node]);
+                degree[node] = sorted.size();
+            } });
+
+        // Pass 2: keep only the neighbours ranked above the node, still sorted by id
+        auto above = [&](NodeId node, NodeId other)
+        {
+            return degree[other] != degree[node] ? degree[other] > degree[node] : other > node;
+        };
+        vector<uint64_t> forwardOffsets(nodeCount + 1, 0);
+        runChunks(chunkCount, [&](size_t chunk)
+                  {
+            for (NodeId node = chunk * ChunkNodes; node < chunkEnd(chunk); ++node)
+            {
+                const NodeId *list = neighbours.data() + offsets[node];
+                forwardOffsets[node + 1] = count_if(list, list + degree[node], [&](NodeId other)
+                                                    { return above(node, other); });
+            } });
+        partial_sum(forwardOffsets.begin(), forwardOffsets.end(), forwardOffsets.begin());
+        vector<NodeId> forward(forwardOffsets.back());
+        runChunks(chunkCount, [&](size_t chunk)
+                  {
+            for (NodeId node = chunk * ChunkNodes; node < chunkEnd(chunk); ++node)
+            {
+                const NodeId *list = neighbours.data() + offsets[node];
+                copy_if(list, list + degree[node], forward.begin() + forwardOffsets[node], [&](NodeId other)
+                        { return above(node, other); });
+            } });
+        vector<NodeId>().swap(neighbours);
+
+        // Pass 3: a triangle u < v < w (by rank) is w found in both forward lists of u and v
+        vector<uint64_t> counts(chunkCount, 0);
+        runChunks(chunkCount, [&](size_t chunk)
+                  {
+            uint64_t triangles = 0;
+            for (NodeId node = chunk * ChunkNodes; node < chunkEnd(chunk); ++node)
+            {
+                const NodeId *list = forward.data() + forwardOffsets[node];
+                size_t size = forwardOffsets[node + 1] - forwardOffsets[node];
+                for (size_t k = 0; k < size; ++k)
+                {
+                    NodeId other = list[k];
+                    intersectSorted(list, size, forward.data() + forwardOffsets[other], forwardOffsets[other + 1] - forwardOffsets[other], [&](NodeId)
+                                    { ++triangles; });
+                }
+            }
+            counts[chunk] = triangles; });
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+        out << "{\"entities\": " << nodeIds.size() << ", \"connected_pairs\": " << forward.size()
+            << ", \"triangles\": " << accumulate(counts.begin(), counts.end(), uint64_t(0))
+            << ", \"milliseconds\": " << static_cast<uint64_t>(seconds * 1000) << "}" << endl;
+    }
+
+    // Makes room for the given number of additional nodes and relationships up front,
+    // so a bulk load does not rehash the lookup tables over and over
+    void reserve(size_t extraNodes, size_t extraRelationships)
+    {
+        nodeIds.reserve(nodeIds.size() + extraNodes);
+        nodeTable.reserve(nodeTable.size() + extraNodes);
+        relationships.reserve(relationships.size() + extraNodes);
+        incoming.reserve(incoming.size() + extraNodes);
+        edgeIndex.reserve(edgeIndex.size() + extraRelationships);
+    }
+
+    // Streams entities and relationships from CSV files straight into the graph, without the
+    // per-row acknowledgements of ADD_ENTITY / ADD_r, and prints a single summary.
+    //   nodes file: header "label,name[,Key...]", then one entity per row; each extra column
+    //               becomes a property named after its header (empty cells are skipped)
+    //   edges file: header "from,to,relation[,Key...]", then one relationship per row
+    // Either path may be empty. Rows with missing fields, duplicate names or unknown endpoints
+    // are counted as skipped.
+    void bulkLoad(const string &nodesPath, const string &edgesPath)
+    {
+        auto started = chrono::steady_clock::now();
+
+        ifstream nodesFile, edgesFile;
+        vector<char> nodesBuffer(1 << 20), edgesBuffer(1 << 20);
+        if (!nodesPath.empty())
+        {
+            nodesFile.rdbuf()->pubsetbuf(nodesBuffer.data(), nodesBuffer.size());
+            nodesFile.open(nodesPath);
+            if (!nodesFile)
+            {
+                out << "{\"error\": \"Cannot open file '" << nodesPath << "'.\"}" << endl;
+                return;
+            }
+        }
+        if (!edgesPath.empty())
+        {
+            edgesFile.rdbuf()->pubsetbuf(edgesBuffer.data(), edgesBuffer.size());
+            edgesFile.open(edgesPath);
+            if (!edgesFile)
+            {
+                out << "{\"error\": \"Cannot open file '" << edgesPath << "'.\"}" << endl;
+                return;
+            }
+        }
+
+        // Pre-size the tables from the line counts (each file has one header line)
+        size_t nodeRows = nodesPath.empty() ? 0 : countLines(nodesPath);
+        size_t edgeRows = edgesPath.empty() ? 0 : countLines(edgesPath);
+        reserve(nodeRows, edgeRows);
+
+        size_t entitiesAdded = 0, relationshipsAdded = 0, skippedRows = 0;
+        string line;
+        vector<string> fields;
+        vector<Symbol> columnKeys;
+
+        if (nodesFile.is_open() && getline(nodesFile, line))
+        {
+            // Property columns are named by the header; intern their keys once
+            splitCsvRow(line, fields);
+            for (size_t i = 2; i < fields.size(); ++i)
+            {
+                columnKeys.push_back(symbols.intern(string(trimView(fields[i]))));
+            }
+
+            string lastLabel;
+            Symbol lastLabelSymbol = NoSymbol;
+            while (getline(nodesFile, line))
+            {
+                splitCsvRow(line, fields);
+                if (fields.size() < 2 || fields[0].empty() || fields[1].empty())
+                {
+                    skippedRows += !(fields.size() == 1 && fields[0].empty()); // Blank lines are not errors
+                    continue;
+                }
+
+                // Rows of the same label usually come together, so skip the symbol lookup then
+                if (lastLabelSymbol == NoSymbol || fields[0] != lastLabel)
+                {
+                    lastLabel = fields[0];
+                    lastLabelSymbol = symbols.intern(lastLabel);
+                }
+
+                NodeId id = insertNode(lastLabelSymbol, fields[1]);
+                if (id == InvalidNode)
+                {
+                    ++skippedRows; // Duplicate name
+                    continue;
+                }
+                ++entitiesAdded;
+
+                for (size_t i = 2; i < fields.size() && i - 2 < columnKeys.size(); ++i)
+                {
+                    if (!fields[i].empty())
+                    {
+                        setNodeProperty(nodeTable[id], columnKeys[i - 2], fields[i]);
+                    }
+                }
+            }
+        }
+
+        columnKeys.clear();
+        if (edgesFile.is_open() && getline(edgesFile, line))
+        {
+            splitCsvRow(line, fields);
+            for (size_t i = 3; i < fields.size(); ++i)
+            {
+                columnKeys.push_back(symbols.intern(string(trimView(fields[i]))));
+            }
+
+            while (getline(edgesFile, line))
+            {
+                splitCsvRow(line, fields);
+                if (fields.size() < 3 || fields[2].empty())
+                {
+                    skippedRows += !(fields.size() == 1 && fields[0].empty());
+                    continue;
+                }
+
+                NodeId from = lookupNode(fields[0]);
+                NodeId to = lookupNode(fields[1]);
+                if (from == InvalidNode || to == InvalidNode)
+                {
+                    ++skippedRows; // Unknown endpoint
+                    continue;
+                }
+
+                auto inserted = insertRelationship(from, to, symbols.intern(fields[2]));
+                relationshipsAdded += inserted.second;
+
+                for (size_t i = 3; i < fields.size() && i - 3 < columnKeys.size(); ++i)
+                {
+                    if (!fields[i].empty())
+                    {
+                        inserted.first->setProperty(columnKeys[i - 3], fields[i]);
+                    }
+                }
+            }
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        size_t rows = entitiesAdded + relationshipsAdded + skippedRows;
+        out << "{\"status\": \"success\", \"entities\": " << entitiesAdded
+            << ", \"relationships\": " << relationshipsAdded
+            << ", \"skipped_rows\": " << skippedRows
+            << ", \"seconds\": " << seconds
+            << ", \"rows_per_second\": " << static_cast<uint64_t>(seconds > 0 ? rows / seconds : rows) << "}" << endl;
+    }
+
+    // Writes the whole graph to `path` in a compact binary form:
+    //   "GDBSNAP1", last lsn, symbol table, indexed property keys (range indexes flagged with RangeIndexFlag),
+    //   entities (name, label, properties), relationships (endpoint ordinals, type, properties),
+    //   columnar tables ((label, key) pairs)
+    bool saveSnapshot(const string &path, uint64_t lastLsn)
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            return false;
+        }
+        vector<char> buffer(1 << 20);
+        setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+        fwrite("GDBSNAP1", 1, 8, file);
+        writeU64(file, lastLsn);
+
+        writeU32(file, symbols.size());
+        for (Symbol symbol = 0; symbol < symbols.size(); ++symbol)
+        {
+            writeString(file, symbols.name(symbol));
+        }
+
+        vector<Symbol> indexed = propertyIndex.indexedKeys();
+        vector<Symbol> ranged = propertyIndex.rangeKeys();
+        writeU32(file, indexed.size() + ranged.size());
+        for (Symbol key : indexed)
+        {
+            writeU32(file, key);
+        }
+        for (Symbol key : ranged)
+        {
+            writeU32(file, key | RangeIndexFlag);
+        }
+
+        // Entities are numbered densely in the order written, skipping free slots
+        vector<uint32_t> ordinal(nodeTable.size());
+        writeU64(file, nodeIds.size());
+        uint32_t written = 0;
+        for (Node *node : nodeTable)
+        {
+            if (!node)
+            {
+                continue;
+            }
+            ordinal[node->id] = written++;
+            writeString(file, node->name);
+            writeU32(file, node->label);
+            writeU32(file, node->properties.size());
+            for (const auto &property : node->properties)
+            {
+                writeU32(file, property.first);
+                writeString(file, property.second.text);
+            }
+        }
+
+        writeU64(file, edgeIndex.size());
+        for (Node *node : nodeTable)
+        {
+            if (!node)
+            {
+                continue;
+            }
+            for (const Edge &edge : relationships[node->id])
+            {
+                Relationship *relationship = edge.relationship;
+                writeU32(file, ordinal[node->id]);
+                writeU32(file, ordinal[edge.node]);
+                writeU32(file, relationship->relation);
+                writeU32(file, relationship->properties.size());
+                for (const auto &property : relationship->properties)
+                {
+                    writeU32(file, property.first);
+                    writeString(file, property.second);
+                }
+            }
+        }
+
+        // Columnar tables, as (label, key) pairs
+        vector<pair<Symbol, Symbol>> columns;
+        for (const auto &table : labelTables)
+        {
+            for (const auto &column : table.second.columns)
+            {
+                columns.emplace_back(table.first, column.first);
+            }
+        }
+        writeU32(file, columns.size());
+        for (const auto &column : columns)
+        {
+            writeU32(file, column.first);
+            writeU32(file, column.second);
+        }
+
+        bool ok = !ferror(file);
+        ok = syncFile(file) && ok;
+        ok = fclose(file) == 0 && ok;
+        return ok;
+    }
+
+    // Loads a snapshot written by saveSnapshot into an empty graph. Returns false if the file is
+    // missing or damaged; `lastLsn` receives the log position the snapshot covers.
+    bool loadSnapshot(const string &path, uint64_t &lastLsn)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            return false;
+        }
+        vector<char> buffer(1 << 20);
+        setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+        char magic[8];
+        bool ok = fread(magic, 1, 8, file) == 8 && string(magic, 8) == "GDBSNAP1" && readU64(file, lastLsn);
+
+        // Map the snapshot's symbols onto this process's table
+        uint32_t count = 0;
+        vector<Symbol> symbolMap;
+        string text;
+        ok = ok && readU32(file, count);
+        for (uint32_t i = 0; ok && i < count; ++i)
+        {
+            ok = readString(file, text);
+            symbolMap.push_back(symbols.intern(text));
+        }
+        auto mapped = [&](uint32_t symbol, Symbol &result)
+        {
+            if (symbol >= symbolMap.size())
+            {
+                return false;
+            }
+            result = symbolMap[symbol];
+            return true;
+        };
+
+        vector<Symbol> indexed, ranged;
+        ok = ok && readU32(file, count);
+        for (uint32_t i = 0; ok && i < count; ++i)
+        {
+            uint32_t key = 0;
+            Symbol symbol = NoSymbol;
+            ok = readU32(file, key) && mapped(key & ~RangeIndexFlag, symbol);
+            if (ok)
+            {
+                (key & RangeIndexFlag ? ranged : indexed).push_back(symbol);
+            }
+        }
+
+        uint64_t nodeCount = 0, edgeCount = 0;
+        vector<NodeId> ids;
+        ok = ok && readU64(file, nodeCount);
+        if (ok)
+        {
+            reserve(nodeCount, 0);
+            ids.reserve(nodeCount);
+        }
+        string name, value;
+        for (uint64_t i = 0; ok && i < nodeCount; ++i)
+        {
+            uint32_t label, properties;
+            Symbol labelSymbol;
+            ok = readString(file, name) && readU32(file, label) && mapped(label, labelSymbol) && readU32(file, properties);
+            NodeId id = ok ? insertNode(labelSymbol, name) : InvalidNode;
+            ok = ok && id != InvalidNode;
+            ids.push_back(id);
+            for (uint32_t p = 0; ok && p < properties; ++p)
+            {
+                uint32_t key;
+                Symbol keySymbol;
+                ok = readU32(file, key) && mapped(key, keySymbol) && readString(file, value);
+                if (ok)
+                {
+                    nodeTable[id]->updateProperty(keySymbol, value);
+                }
+            }
+        }
+
+        ok = ok && readU64(file, edgeCount);
+        if (ok)
+        {
+            reserve(0, edgeCount);
+        }
+        for (uint64_t i = 0; ok && i < edgeCount; ++i)
+        {
+            uint32_t from, to, relation, properties;
+            Symbol relationSymbol;
+            ok = readU32(file, from) && readU32(file, to) && from < ids.size() && to < ids.size() &&
+                 readU32(file, relation) && mapped(relation, relationSymbol) && readU32(file, properties);
+            Relationship *relationship = ok ? insertRelationship(ids[from], ids[to], relationSymbol).first : nullptr;
+            for (uint32_t p = 0; ok && p < properties; ++p)
+            {
+                uint32_t key;
+                Symbol keySymbol;
+                ok = readU32(file, key) && mapped(key, keySymbol) && readString(file, value);
+                if (ok)
+                {
+                    relationship->setProperty(keySymbol, value);
+                }
+            }
+        }
+
+        // Columnar tables (missing in snapshots written before CREATE_COLUMNS existed)
+        vector<pair<Symbol, Symbol>> columns;
+        if (ok && readU32(file, count))
+        {
+            for (uint32_t i = 0; ok && i < count; ++i)
+            {
+                uint32_t label, key;
+                Symbol labelSymbol = 0, keySymbol = 0;
+                ok = readU32(file, label) && readU32(file, key) && mapped(label, labelSymbol) && mapped(key, keySymbol);
+                if (ok)
+                {
+                    columns.emplace_back(labelSymbol, keySymbol);
+                }
+            }
+        }
+        fclose(file);
+
+        // Rebuild the property indexes in one pass each
+        for (Symbol key : indexed)
+        {
+            propertyIndex.createIndex(key, nodeTable);
+        }
+        for (Symbol key : ranged)
+        {
+            propertyIndex.createRangeIndex(key, nodeTable);
+        }
+        out.setMuted(true);
+        for (const auto &column : columns)
+        {
+            createColumns(symbols.name(column.first), {symbols.name(column.second)});
+        }
+        out.setMuted(false);
+        return ok;
+    }
+
+    // Writes a snapshot of the current graph and restarts the log. The snapshot is written to a
+    // temporary file and renamed into place, so a crash leaves either the old or the new one;
+    // records it already covers are skipped on replay even if the log was not truncated yet.
+    // Returns false if any step failed; if the log could not be restarted it stays closed, and
+    // logged queries are refused until a checkpoint succeeds.
+    bool writeCheckpoint()
+    {
+        if (!wal.sync())
+        {
+            return false;
+        }
+        uint64_t lastLsn = wal.lastLsn();
+        string snapshotPath = dataDirectory + "/snapshot.bin";
+        string temporaryPath = snapshotPath + ".tmp";
+
+        if (!saveSnapshot(temporaryPath, lastLsn))
+        {
+            return false;
+        }
+        error_code error;
+        filesystem::rename(temporaryPath, snapshotPath, error);
+        if (error || !syncDirectory(dataDirectory))
+        {
+            return false;
+        }
+
+        loggedSinceCheckpoint = 0;
+        return wal.open(dataDirectory + "/wal.log", lastLsn, true);
+    }
+
+public:
+    // Enables durability in `directory`: loads the latest snapshot, replays the log records written
+    // after it, then checkpoints so the log starts empty. Must be called on an empty graph.
+    bool openStorage(const string &directory, size_t fsyncEvery, size_t checkpointInterval)
+    {
+        error_code error;
+        filesystem::create_directories(directory, error);
+        dataDirectory = directory;
+        checkpointEvery = checkpointInterval;
+        wal.setFsyncEvery(fsyncEvery);
+
+        uint64_t lastLsn = 0;
+        string snapshotPath = directory + "/snapshot.bin";
+        if (filesystem::exists(snapshotPath) && !loadSnapshot(snapshotPath, lastLsn))
+        {
+            out << "{\"error\": \"Snapshot '" << snapshotPath << "' is damaged.\"}" << endl;
+            return false;
+        }
+
+        // Replay the log tail with responses muted. A last line without its newline was torn by
+        // a crash and is ignored.
+        size_t replayed = 0;
+        ifstream log(directory + "/wal.log");
+        string line;
+        replaying = true;
+        out.setMuted(true);
+        while (getline(log, line) && !log.eof())
+        {
+            size_t space = line.find(' ');
+            uint64_t lsn = 0;
+            if (space == string::npos ||
+                from_chars(line.data(), line.data() + space, lsn).ec != errc() || lsn <= lastLsn)
+            {
+                continue;
+            }
+            interpretQuery(line.substr(space + 1));
+            lastLsn = lsn;
+            ++replayed;
+        }
+        out.setMuted(false);
+        replaying = false;
+
+        if (!wal.open(directory + "/wal.log", lastLsn, false) || !writeCheckpoint())
+        {
+            out << "{\"error\": \"Cannot write to data directory '" << directory << "'.\"}" << endl;
+            return false;
+        }
+
+        out << "{\"status\": \"success\", \"message\": \"Recovered " << nodeIds.size() << " entities and "
+            << edgeIndex.size() << " relationships (" << replayed << " log records replayed).\"}" << endl;
+        return true;
+    }
+
+    // Enables or disables the queries that name server-side files (BULK_LOAD, EXPORT_IMAGE)
+    void allowFileCommands(bool allowed)
+    {
+        fileCommandsAllowed = allowed;
+    }
+
+    // Makes logged queries durable; main() calls this before it flushes their responses. Returns
+    // false if queries already answered may not survive a restart.
+    bool syncLog()
+    {
+        unique_lock<shared_mutex> guard(graphMutex);
+        return wal.sync();
+    }
+
+    void checkpoint()
+    {
+        if (dataDirectory.empty())
+        {
+            out << "{\"error\": \"CHECKPOINT requires a data directory (start with --data-dir).\"}" << endl;
+            return;
+        }
+        if (!writeCheckpoint())
+        {
+            out << "{\"error\": \"Checkpoint failed.\"}" << endl;
+            return;
+        }
+        out << "{\"status\": \"success\", \"message\": \"Checkpoint written at log position " << wal.lastLsn() << ".\"}" << endl;
+    }
+
+    // Writes the graph as a read-only image (see ImageHeader) that --image can map directly.
+    // Relationship properties are not part of the image; it serves FIND, GET_INFO and GET_LABELED.
+    void exportImage(const string &path)
+    {
+        auto started = chrono::steady_clock::now();
+
+        // Entities in name order; the image refers to them by their position in this order
+        vector<Node *> sorted;
+        sorted.reserve(nodeIds.size());
+        for (Node *node : nodeTable)
+        {
+            if (node)
+            {
+                sorted.push_back(node);
+            }
+        }
+        sort(sorted.begin(), sorted.end(), [](const Node *a, const Node *b)
+             { return a->name < b->name; });
+        vector<uint32_t> position(nodeTable.size());
+        for (uint32_t i = 0; i < sorted.size(); ++i)
+        {
+            position[sorted[i]->id] = i;
+        }
+
+        string strings;
+        auto addString = [&strings](const string &text)
+        {
+            ImageString reference = {strings.size(), static_cast<uint32_t>(text.size()), 0};
+            strings += text;
+            return reference;
+        };
+
+        vector<ImageString> symbolStrings(symbols.size());
+        vector<Symbol> symbolsByName(symbols.size());
+        for (Symbol symbol = 0; symbol < symbols.size(); ++symbol)
+        {
+            symbolStrings[symbol] = addString(symbols.name(symbol));
+            symbolsByName[symbol] = symbol;
+        }
+        sort(symbolsByName.begin(), symbolsByName.end(), [](Symbol a, Symbol b)
+             { return symbols.name(a) < symbols.name(b); });
+
+        vector<ImageNode> nodes(sorted.size());
+        vector<uint64_t> edgeOffsets(sorted.size() + 1, 0);
+        vector<ImageEdge> edges;
+        vector<ImageProperty> properties;
+        edges.reserve(edgeIndex.size());
+        for (uint32_t i = 0; i < sorted.size(); ++i)
+        {
+            Node *node = sorted[i];
+            nodes[i] = {addString(node->name), node->label, static_cast<uint32_t>(node->properties.size()), properties.size()};
+            for (const auto &property : node->properties)
+            {
+                properties.push_back({addString(property.second.text), property.first, 0});
+            }
+            for (const Edge &edge : relationships[node->id])
+            {
+                edges.push_back({position[edge.node], edge.relationship->relation});
+            }
+            edgeOffsets[i + 1] = edges.size();
+        }
+
+        // Label members are node indexes, so each range comes out in name order after sorting
+        vector<ImageLabel> labels;
+        vector<uint32_t> labelMembers;
+        labelMembers.reserve(sorted.size());
+        for (const auto &entry : labelIndex)
+        {
+            ImageLabel label = {entry.first, 0, labelMembers.size(), entry.second.size()};
+            for (Node *node : entry.second)
+            {
+                labelMembers.push_back(position[node->id]);
+            }
+            sort(labelMembers.begin() + label.firstMember, labelMembers.end());
+            labels.push_back(label);
+        }
+        sort(labels.begin(), labels.end(), [](const ImageLabel &a, const ImageLabel &b)
+             { return a.label < b.label; });
+
+        // Lay the sections out back to back, each aligned to 8 bytes
+        ImageHeader header = {};
+        memcpy(header.magic, "GDBIMG01", 8);
+        uint64_t offset = sizeof(ImageHeader);
+        auto place = [&offset](ImageSection &section, uint64_t count, size_t elementSize)
+        {
+            section = {offset, count};
+            offset = (offset + count * elementSize + 7) & ~uint64_t(7);
+        };
+        place(header.strings, strings.size(), 1);
+        place(header.symbols, symbolStrings.size(), sizeof(ImageString));
+        place(header.symbolsByName, symbolsByName.size(), sizeof(Symbol));
+        place(header.nodes, nodes.size(), sizeof(ImageNode));
+        place(header.edgeOffsets, edgeOffsets.size(), sizeof(uint64_t));
+        place(header.edges, edges.size(), sizeof(ImageEdge));
+        place(header.properties, properties.size(), sizeof(ImageProperty));
+        place(header.labels, labels.size(), sizeof(ImageLabel));
+        place(header.labelMembers, labelMembers.size(), sizeof(uint32_t));
+        header.fileSize = offset;
+
+        string temporaryPath = path + ".tmp";
+        FILE *file = fopen(temporaryPath.c_str(), "wb");
+        if (!file)
+        {
+            out << "{\"error\": \"Cannot write image '" << path << "'.\"}" << endl;
+            return;
+        }
+        auto writeSection = [file](const ImageSection &section, const void *data, size_t bytes)
+        {
+            static const char padding[8] = {};
+            fseek(file, section.offset, SEEK_SET);
+            fwrite(data, 1, bytes, file);
+            fwrite(padding, 1, (8 - bytes % 8) % 8, file);
+        };
+        fwrite(&header, sizeof(header), 1, file);
+        writeSection(header.strings, strings.data(), strings.size());
+        writeSection(header.symbols, symbolStrings.data(), symbolStrings.size() * sizeof(ImageString));
+        writeSection(header.symbolsByName, symbolsByName.data(), symbolsByName.size() * sizeof(Symbol));
+        writeSection(header.nodes, nodes.data(), nodes.size() * sizeof(ImageNode));
+        writeSection(header.edgeOffsets, edgeOffsets.data(), edgeOffsets.size() * sizeof(uint64_t));
+        writeSection(header.edges, edges.data(), edges.size() * sizeof(ImageEdge));
+        writeSection(header.properties, properties.data(), properties.size() * sizeof(ImageProperty));
+        writeSection(header.labels, labels.data(), labels.size() * sizeof(ImageLabel));
+        writeSection(header.labelMembers, labelMembers.data(), labelMembers.size() * sizeof(uint32_t));
+
+        bool ok = !ferror(file);
+        ok = syncFile(file) && ok;
+        ok = fclose(file) == 0 && ok;
+        error_code error;
+        if (ok)
+        {
+            filesystem::rename(temporaryPath, path, error);
+        }
+        if (!ok || error)
+        {
+            out << "{\"error\": \"Cannot write image '" << path << "'.\"}" << endl;
+            return;
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        out << "{\"status\": \"success\", \"message\": \"Image '" << path << "' written with " << nodes.size()
+            << " entities and " << edges.size() << " relationships (" << header.fileSize << " bytes) in "
+            << static_cast<uint64_t>(seconds * 1000) << " ms.\"}" << endl;
+    }
+
+    void getMemoryStats()
+    {
+        out << "{\n";
+        out << "  \"entities\": {\"live\": " << nodePool.liveObjects()
+            << ", \"created\": " << nodePool.totalCreated()
+            << ", \"reused_slots\": " << nodePool.reusedSlots()
+            << ", \"slabs\": " << nodePool.slabCount()
+            << ", \"reserved_bytes\": " << nodePool.reservedBytes() << "},\n";
+        out << "  \"relationships\": {\"live\": " << relationshipPool.liveObjects()
+            << ", \"created\": " << relationshipPool.totalCreated()
+            << ", \"reused_slots\": " << relationshipPool.reusedSlots()
+            << ", \"slabs\": " << relationshipPool.slabCount()
+            << ", \"reserved_bytes\": " << relationshipPool.reservedBytes() << "}\n";
+        out << "}" << endl;
+    }
+
+    void findNodes(const vector<PropertyPredicate> &predicates)
+    {
+        // Error handling for empty predicate vector
+        if (predicates.empty())
+        {
+            out << "{\"error\": \"No properties specified for search.\"}" << endl;
+            return;
+        }
+
+        out << "{\n";
+
+        bool firstPropertySection = true;
+        bool anyMatchesFound = false; // Track if any matches are found overall
+
+        // Iterate over each predicate to find matching nodes
+        for (const PropertyPredicate &predicate : predicates)
+        {
+            Symbol keySymbol = symbols.find(predicate.key);
+
+            // Collect all node names that match the current predicate
+            vector<string> matchingNodes;
+            if (keySymbol == NoSymbol)
+            {
+                // No entity has ever had this property
+            }
+            else if (predicate.equality && propertyIndex.has(keySymbol))
+            {
+                // Indexed key: only the matching nodes are visited
+                const unordered_set<Node *> *indexed = propertyIndex.find(keySymbol, predicate.lower.text);
+                if (indexed)
+                {
+                    for (Node *node : *indexed)
+                    {
+                        matchingNodes.push_back(node->name);
+                    }
+                }
+            }
+            else if (propertyIndex.hasRange(keySymbol))
+            {
+                // Range indexed key: walk the sorted values between the bounds, smallest first
+                bool upperInclusive = predicate.equality || predicate.upperInclusive;
+                const PropertyValue *upper = predicate.equality ? &predicate.lower : predicate.hasUpper ? &predicate.upper : nullptr;
+                propertyIndex.scanRange(keySymbol, predicate.hasLower || predicate.equality ? &predicate.lower : nullptr,
+                                        predicate.lowerInclusive, upper, upperInclusive, [&](Node *node, const PropertyValue &value)
+                                        {
+                    if (predicate.matches(value))
+                    {
+                        matchingNodes.push_back(node->name);
+                    } });
+            }
+            else
+            {
+                for (Node *node : nodeTable)
+                {
+                    if (!node)
+                    {
+                        continue; // Free slot
+                    }
+                    auto it = node->properties.find(keySymbol);
+
+                    // Check if the property exists and satisfies the predicate
+                    if (it != node->properties.end() && predicate.matches(it->second))
+                    {
+                        matchingNodes.push_back(node->name);
+                    }
+                }
+            }
+
+            // If matches are found for this property, print them
+            if (!matchingNodes.empty())
+            {
+                anyMatchesFound = true;
+                if (!firstPropertySection)
+                {
+                    out << ",\n"; // Add comma between different property sections
+                }
+
+                // Print property information
+                out << "  \"property\":\"" << predicate.text << "\": {\n"
+                    << "    \"nodes\": [\n";
+
+                // Print each node name under "nodes" array
+                for (size_t i = 0; i < matchingNodes.size(); ++i)
+                {
+                    out << "      \"" << matchingNodes[i] << "\"";
+                    if (i < matchingNodes.size() - 1)
+                    {
+                        out << ",";
+                    }
+                    out << "\n";
+                }
+
+                out << "    ]\n"
+                    << "  }";
+                firstPropertySection = false;
+            }
+        }
+
+        // If no nodes matched any key-value pair, output a no matches message
+        if (!anyMatchesFound)
+        {
+            if (!firstPropertySection)
+            {
+                out << ",\n";
+            }
+            out << "  \"message\": \"No matching nodes found for specified properties.\"\n";
+        }
+
+        out << "\n}\n";
+    }
+
+private:
+    // Handler of one query command, called with the already tokenized query
+    using QueryHandler = void (Graph::*)(const ParsedQuery &);
+
+    // How a command may touch the graph, which decides the lock it runs under
+    enum class Access
+    {
+        Read,     // Shared lock; runs alongside other reads
+        Write,    // Exclusive lock, written to the write-ahead log before it runs
+        Exclusive // Exclusive lock but not logged (CHECKPOINT)
+    };
+
+    struct CommandInfo
+    {
+        QueryHandler handler;
+        Access access;
+        bool namesFiles = false; // Reads or writes a server-side path given in the query
+    };
+
+    // A query parsed once and kept for reuse: by EXECUTE, and by MATCH for its plan
+    struct PreparedQuery
+    {
+        string text; // Normalized query text; command, args and pattern point into it
+        string_view command;
+        const CommandInfo *info = nullptr;
+        vector<string_view> args;
+        size_t parameterCount = 0;        // Highest "$n" in the text
+        MatchPattern pattern;             // MATCH only
+        shared_ptr<const MatchPlan> plan; // MATCH only, guarded by queryCacheMutex
+    };
+
+    // Parsed queries by normalized text (MATCH and PREPARE go through it) and prepared statements
+    // by name. Readers share them, so they have their own lock.
+    mutex queryCacheMutex;
+    LruCache<shared_ptr<PreparedQuery>> queryCache{1024};
+    unordered_map<string, shared_ptr<PreparedQuery>> preparedStatements;
+    size_t cacheHits = 0, cacheMisses = 0, replans = 0;
+
+    // Returns the parsed form of `query` from the cache, parsing and caching it on a miss.
+    // Returns nullptr with `error` set if the query is malformed. Requires queryCacheMutex.
+    shared_ptr<PreparedQuery> prepareQuery(string_view query, string &error)
+    {
+        string text = normalizeQuery(query);
+        if (shared_ptr<PreparedQuery> *cached = queryCache.find(text))
+        {
+            ++cacheHits;
+            return *cached;
+        }
+        ++cacheMisses;
+
+        auto prepared = make_shared<PreparedQuery>();
+        prepared->text = move(text);
+        ParsedQuery parsed;
+        ParseStatus status = parseQuery(prepared->text, parsed);
+        auto it = commandTable().find(parsed.command);
+        if (status == ParseStatus::MissingOpenBrace || it == commandTable().end())
+        {
+            error = "Invalid query format.";
+            return nullptr;
+        }
+        if (status != ParseStatus::Ok)
+        {
+            error = "Malformed " + string(parsed.command) + " query - " +
+                    (status == ParseStatus::MissingCloseBrace ? string("missing closing brace.") : "more than " + to_string(ParsedQuery::MaxArgs) + " fields.");
+            return nullptr;
+        }
+        prepared->command = parsed.command;
+        prepared->info = &it->second;
+        prepared->args.assign(parsed.args, parsed.args + parsed.argCount);
+        prepared->parameterCount = highestParameter(prepared->text);
+
+        if (prepared->command == "MATCH")
+        {
+            if (parsed.argCount == 0)
+            {
+                error = "MATCH query requires a pattern.";
+                return nullptr;
+            }
+
+            // Filters are separated by commas too, so the pattern is parsed from the whole body.
+            // It is cut from the text itself: an empty first or last field has no position.
+            string_view text = prepared->text;
+            size_t open = text.find('{'), close = text.rfind('}');
+            string_view body = trimView(text.substr(open + 1, close - open - 1));
+            size_t errorAt;
+            if (!parseMatchPattern(body, prepared->pattern, errorAt))
+            {
+                error = "Malformed MATCH pattern at \\\"" + string(body.substr(errorAt, 20)) + "\\\".";
+                return nullptr;
+            }
+        }
+
+        queryCache.insert(prepared->text, prepared);
+        return prepared;
+    }
+
+    // Runs a parsed MATCH, reusing its plan while it is fresh and remembering a new one
+    void executeMatch(PreparedQuery &prepared, const vector<string_view> &parameters)
+    {
+        shared_ptr<const MatchPlan> cached;
+        {
+            lock_guard<mutex> lock(queryCacheMutex);
+            cached = prepared.plan;
+        }
+        shared_ptr<const MatchPlan> plan = cached;
+        matchPattern(prepared.pattern, parameters, plan);
+        if (plan != cached)
+        {
+            lock_guard<mutex> lock(queryCacheMutex);
+            replans += cached != nullptr;
+            prepared.plan = plan;
+        }
+    }
+
+    // Runs `run` under the lock `access` calls for. A logged write is appended to the write-ahead
+    // log as `logText` before it runs.
+    template <typename Run>
+    void runCommand(Access access, string_view logText, Run run)
+    {
+        if (access == Access::Read)
+        {
+            shared_lock<shared_mutex> guard(graphMutex);
+            run();
+            return;
+        }
+        unique_lock<shared_mutex> guard(graphMutex);
+
+        // Write-ahead: the query is in the log before it changes anything, or it does not run
+        bool logged = access == Access::Write && !dataDirectory.empty() && !replaying;
+        if (logged && !wal.append(logText))
+        {
+            out << "{\"error\": \"Cannot write to the write-ahead log, so the query was not run. Run CHECKPOINT once '"
+                << dataDirectory << "' is writable again.\"}" << endl;
+            return;
+        }
+
+        run();
+        ++version;
+
+        if (logged && checkpointEvery > 0 && ++loggedSinceCheckpoint >= checkpointEvery && !writeCheckpoint())
+        {
+            out << "{\"error\": \"Automatic checkpoint failed.\"}" << endl;
+        }
+    }
+
+    // PREPARE name AS QUERY{...}: parses the query once and keeps it under `name` for EXECUTE
+    void prepareStatement(string_view text)
+    {
+        text = trimView(text.substr(strlen("PREPARE")));
+        size_t nameEnd = text.find_first_of(" \t");
+        string_view name = text.substr(0, nameEnd);
+        string_view rest = nameEnd == string_view::npos ? string_view() : trimView(text.substr(nameEnd));
+        if (name.empty() || rest.substr(0, 3) != "AS " || trimView(rest.substr(3)).empty())
+        {
+            out << "{\"error\": \"PREPARE query requires the form PREPARE name AS QUERY{...}.\"}" << endl;
+            return;
+        }
+
+        string error;
+        size_t parameterCount = 0;
+        {
+            lock_guard<mutex> lock(queryCacheMutex);
+            shared_ptr<PreparedQuery> prepared = prepareQuery(rest.substr(3), error);
+            if (prepared)
+            {
+                preparedStatements[string(name)] = prepared;
+                parameterCount = prepared->parameterCount;
+            }
+        }
+        if (!error.empty())
+        {
+            out << "{\"error\": \"" << error << "\"}" << endl;
+            return;
+        }
+        out << "{\"status\": \"success\", \"message\": \"Statement '" << name << "' prepared with "
+            << parameterCount << " parameter(s).\"}" << endl;
+    }
+
+    // EXECUTE name{value1,value2...}: runs a prepared statement with "$n" bound to the n-th value,
+    // without parsing the statement again
+    void executeStatement(const ParsedQuery &query)
+    {
+        string_view name = trimView(query.command.substr(strlen("EXECUTE")));
+        shared_ptr<PreparedQuery> statement;
+        {
+            lock_guard<mutex> lock(queryCacheMutex);
+            auto it = preparedStatements.find(string(name));
+            if (it != preparedStatements.end())
+            {
+                statement = it->second;
+            }
+        }
+        if (!statement)
+        {
+            out << "{\"error\": \"No prepared statement named '" << name << "'.\"}" << endl;
+            return;
+        }
+        if (query.argCount != statement->parameterCount)
+        {
+            out << "{\"error\": \"Statement '" << name << "' expects " << statement->parameterCount
+                << " parameter(s), got " << query.argCount << ".\"}" << endl;
+            return;
+        }
+
+        vector<string_view> parameters(query.args, query.args + query.argCount);
+        if (statement->command == "MATCH")
+        {
+            runCommand(Access::Read, string_view(), [&]()
+                       { executeMatch(*statement, parameters); });
+            return;
+        }
+
+        // Bind the parameters into the stored arguments; a logged write is logged with its values
+        static thread_local vector<string> values;
+        static thread_local ParsedQuery bound;
+        values.resize(statement->args.size());
+        bound.command = statement->command;
+        bound.argCount = statement->args.size();
+        string logText;
+        if (statement->info->access == Access::Write)
+        {
+            logText.append(statement->command).append("{");
+        }
+        for (size_t i = 0; i < statement->args.size(); ++i)
+        {
+            substituteParameters(statement->args[i], parameters, values[i]);
+            bound.args[i] = values[i];
+            if (statement->info->access == Access::Write)
+            {
+                logText.append(i ? "," : "").append(values[i]);
+            }
+        }
+        if (statement->info->access == Access::Write)
+        {
+            logText.append("}");
+        }
+        if (statement->info->namesFiles && !fileCommandsAllowed)
+        {
+            out << "{\"error\": \"" << statement->command << " is not available to socket clients.\"}" << endl;
+            return;
+        }
+        runCommand(statement->info->access, logText, [&]()
+                   { (this->*(statement->info->handler))(bound); });
+    }
+
+    // Copies arguments [first, argCount) into strings for the Graph API
+    static vector<string> argsFrom(const ParsedQuery &query, size_t first)
+    {
+        vector<string> values;
+        for (size_t i = first; i < query.argCount; ++i)
+        {
+            values.emplace_back(query.args[i]);
+        }
+        return values;
+    }
+
+    void handleAddEntity(const ParsedQuery &query)
+    {
+        if (query.argCount < 2)
+        {
+            out << "{\"error\": \"Missing comma between label and name.\"}" << endl;
+            return;
+        }
+        addNode(string(query.args[0]), string(query.args[1]));
+    }
+
+    void handleAddProperty(const ParsedQuery &query)
+    {
+        if (query.argCount < 2)
+        {
+            out << "{\"error\": \"Missing comma between name and properties.\"}" << endl;
+            return;
+        }
+
+        // Validate every property pair before touching the entity
+        string_view keys[ParsedQuery::MaxArgs], values[ParsedQuery::MaxArgs];
+        for (size_t i = 1; i < query.argCount; ++i)
+        {
+            if (!splitKeyValue(query.args[i], keys[i], values[i]))
+            {
+                out << "{\"error\": \"Invalid property format - missing colon or comma between properties.\"}" << endl;
+                return;
+            }
+        }
+
+        string name(query.args[0]);
+        for (size_t i = 1; i < query.argCount; ++i)
+        {
+            addNodeProperty(name, string(keys[i]), string(values[i]));
+        }
+        out << "{\"status\": \"success\", \"message\": \"Properties added to entity \""
+            << name << "\" successfully.\"}" << endl;
+    }
+
+    void handleGetInfo(const ParsedQuery &query)
+    {
+        if (query.argCount < 2 || query.args[0].empty())
+        {
+            out << "{\"error\": \"Malformed GET_INFO query - name or keys missing.\"}" << endl;
+            return;
+        }
+        for (size_t i = 1; i < query.argCount; ++i)
+        {
+            if (query.args[i].empty())
+            {
+                out << "{\"error\": \"Malformed GET_INFO query - empty key found.\"}" << endl;
+                return;
+            }
+        }
+
+        // Retrieve properties in JSON format
+        getNodeProperty(string(query.args[0]), argsFrom(query, 1));
+    }
+
+    void handleDeleteInfo(const ParsedQuery &query)
+    {
+        if (query.argCount < 2 || query.args[0].empty())
+        {
+            out << "{\"error\": \"Malformed DELETE_INFO query - name or keys missing.\"}" << endl;
+            return;
+        }
+        for (size_t i = 1; i < query.argCount; ++i)
+        {
+            if (query.args[i].empty())
+            {
+                out << "{\"error\": \"Malformed DELETE_INFO query - empty key found.\"}" << endl;
+                return;
+            }
+        }
+
+        deleteNodeProperty(string(query.args[0]), argsFrom(query, 1));
+    }
+
+    void handleGetLabeled(const ParsedQuery &query)
+    {
+        if (query.argCount < 1 || query.args[0].empty())
+        {
+            out << "Error: Malformed GET_LABELED query - label is missing." << endl;
+            return;
+        }
+
+        // Retrieve nodes by label and print them in JSON format
+        getNodesByLabel(string(query.args[0]));
+    }
+
+    void handleAddRelationship(const ParsedQuery &query)
+    {
+        if (query.argCount < 3 || query.args[0].empty() || query.args[1].empty() || query.args[2].empty())
+        {
+            out << "{\"error\": \"Malformed ADD_r query - one or more parameters are missing.\"}" << endl;
+            return;
+        }
+        addRelationship(string(query.args[0]), string(query.args[1]), string(query.args[2]));
+    }
+
+    void handleAddRelationshipProperty(const ParsedQuery &query)
+    {
+        if (query.argCount < 3 || query.args[0].empty() || query.args[1].empty())
+        {
+            out << "Error: Malformed ADD_r_PROPERTY query - Name1, Name2, or properties missing." << endl;
+            return;
+        }
+
+        // Validate every property pair before touching the relationship
+        string_view keys[ParsedQuery::MaxArgs], values[ParsedQuery::MaxArgs];
+        for (size_t i = 2; i < query.argCount; ++i)
+        {
+            if (!splitKeyValue(query.args[i], keys[i], values[i]))
+            {
+                out << "Error: Malformed property pair \"" << query.args[i] << "\" - missing colon." << endl;
+                return;
+            }
+            if (keys[i].empty() || values[i].empty())
+            {
+                out << "Error: Empty key or value in property pair \"" << query.args[i] << "\"." << endl;
+                return;
+            }
+        }
+
+        // Add or update the relationship properties
+        string name1(query.args[0]), name2(query.args[1]);
+        for (size_t i = 2; i < query.argCount; ++i)
+        {
+            addRelationshipProperty(name1, name2, string(keys[i]), string(values[i]));
+        }
+        out << "{\"status\": \"success\", \"message\": \"Properties added successfully.\"}" << endl;
+    }
+
+    void handleGetRelationshipInfo(const ParsedQuery &query)
+    {
+        if (query.argCount < 3)
+        {
+            out << "Error: Malformed GET_r_INFO query - missing second comma." << endl;
+            return;
+        }
+        for (size_t i = 2; i < query.argCount; ++i)
+        {
+            if (query.args[i].empty())
+            {
+                out << "Error: Malformed GET_r_INFO query - empty key found." << endl;
+                return;
+            }
+        }
+
+        // Retrieve relationship properties
+        getRelationshipProperty(string(query.args[0]), string(query.args[1]), argsFrom(query, 2));
+    }
+
+    void handleDeleteRelationshipInfo(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, false))
         {
-            cout << "{\"error\": \"No relationships found for node \"" << name1 << "\".\"}" << endl;
             return;
         }
 
-        // Get the set of relationships for name1
-        const auto &fromSet = relationships[name1];
+        // Validate that we have at least 3 parts: name1, name2, and one key or "ALL"
+        if (query.argCount < 3)
+        {
+            out << "Error: DELETE_r_INFO query requires at least a source node, target node, and at least one key or 'ALL'." << endl;
+            return;
+        }
 
-        // Find the specific relationship to name2
-        auto it = std::find_if(fromSet.begin(), fromSet.end(), [&](const auto &relationshipPair)
-                               {
-                                   return relationshipPair.first == name2; // Match the second node
-                               });
+        deleteRelationshipProperty(string(query.args[0]), string(query.args[1]), argsFrom(query, 2));
+    }
 
-        // Check if the relationship exists
-        if (it == fromSet.end())
+    void handleFind(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
         {
-            cout << "{\"error: \"No relationship exists between \"" << name1 << "\" and \"" << name2 << "\".\"}" << endl;
+            return;
+        }
+        if (query.argCount < 1)
+        {
+            out << "{\"error\": \"FIND query requires at least a node name.\"}" << endl;
             return;
         }
 
-        // Retrieve the relationship object
-        Relationship *relationship = it->second; // Get the Relationship* from the found pair
-        if (!relationship)
+        // Collect relationships; "ALL" is passed as an empty filter
+        vector<string> relations = argsFrom(query, 1);
+        if (relations.size() == 1 && relations[0] == "ALL")
+        {
+            relations.clear();
+        }
+        retrieveRelatedNodes(string(query.args[0]), relations);
+    }
+
+    void handleFindIncoming(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (query.argCount < 1)
         {
-            cout << "{\"error\": \"Relationship object is null.\"}" << endl;
+            out << "{\"error\": \"FIND_IN query requires at least a node name.\"}" << endl;
             return;
         }
 
-        // If "ALL" is the only key, display all properties
-        if (keys.size() == 1 && keys[0] == "ALL")
+        // Collect relationships; "ALL" is passed as an empty filter
+        vector<string> relations = argsFrom(query, 1);
+        if (relations.size() == 1 && relations[0] == "ALL")
         {
-            relationship->displayRelationship();
+            relations.clear();
         }
-        else
+        retrieveIncomingNodes(string(query.args[0]), relations);
+    }
+
+    void handleExpand(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
         {
-            // Output properties in JSON-like format
-            cout << "{" << endl;
-            cout << "  \"Relationship\": \"" << relationship->relation << "\",\n  \"Properties\": {\n";
-            bool first = true; // Flag to manage commas between properties
-            for (const string &key : keys)
+            return;
+        }
+        size_t depth;
+        if (query.argCount < 2 || !parseCount(query.args[1], depth) || depth == 0)
+        {
+            out << "{\"error\": \"EXPAND query requires a node name and a depth of at least 1.\"}" << endl;
+            return;
+        }
+
+        vector<string> relations = argsFrom(query, 2);
+        if (relations.size() == 1 && relations[0] == "ALL")
+        {
+            relations.clear();
+        }
+        expandNeighborhood(string(query.args[0]), depth, relations);
+    }
+
+    void handleExpandStats(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        size_t depth;
+        if (query.argCount < 2 || !parseCount(query.args[1], depth) || depth == 0)
+        {
+            out << "{\"error\": \"EXPAND_STATS query requires a node name and a depth of at least 1.\"}" << endl;
+            return;
+        }
+
+        vector<string> relations = argsFrom(query, 2);
+        if (relations.size() == 1 && relations[0] == "ALL")
+        {
+            relations.clear();
+        }
+        expandStatistics(string(query.args[0]), depth, relations);
+    }
+
+    void handleShortestPath(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (query.argCount != 3)
+        {
+            out << "{\"error\": \"SHORTEST_PATH query requires two node names and a weight property.\"}" << endl;
+            return;
+        }
+        shortestPath(string(query.args[0]), string(query.args[1]), string(query.args[2]));
+    }
+
+    void handlePathExists(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        size_t maxDepth;
+        if (query.argCount < 3 || !parseCount(query.args[2], maxDepth))
+        {
+            out << "{\"error\": \"PATH_EXISTS query requires two node names and a maximum depth.\"}" << endl;
+            return;
+        }
+
+        vector<string> relations = argsFrom(query, 3);
+        if (relations.size() == 1 && relations[0] == "ALL")
+        {
+            relations.clear();
+        }
+        pathExists(string(query.args[0]), string(query.args[1]), maxDepth, relations);
+    }
+
+    void handleMatch(const ParsedQuery &query)
+    {
+        // Repeated patterns reuse their parse and plan from the query cache
+        string text = "MATCH{";
+        for (size_t i = 0; i < query.argCount; ++i)
+        {
+            text.append(i ? "," : "").append(query.args[i]);
+        }
+        text += "}";
+
+        string error;
+        shared_ptr<PreparedQuery> prepared;
+        {
+            lock_guard<mutex> lock(queryCacheMutex);
+            prepared = prepareQuery(text, error);
+        }
+        if (!prepared)
+        {
+            out << "{\"error\": \"" << error << "\"}" << endl;
+            return;
+        }
+        executeMatch(*prepared, {});
+    }
+
+    void handleDeleteEntity(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (query.argCount < 2)
+        {
+            out << "{\"error\": \"DELETE_ENTITY query requires both a label and a name.\"}" << endl;
+            return;
+        }
+        deleteNode(string(query.args[0]), string(query.args[1]));
+    }
+
+    void handleDeleteRelationship(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (query.argCount != 3)
+        {
+            out << "{\"error\": \"DELETE_r query requires exactly two node names and a relationship type (or 'ALL').\"}" << endl;
+            return;
+        }
+        deleteRelation(string(query.args[0]), string(query.args[1]), string(query.args[2]));
+    }
+
+    void handleGet(const ParsedQuery &query)
+    {
+        if (query.argCount == 0)
+        {
+            out << "{\"error\": \"Malformed GET query - properties section is empty.\"}" << endl;
+            return;
+        }
+
+        // Parse the conditions: Key:value, comparisons and BETWEEN
+        vector<PropertyPredicate> predicates(query.argCount);
+        for (size_t i = 0; i < query.argCount; ++i)
+        {
+            if (!parsePredicate(query.args[i], predicates[i]))
             {
-                string value = relationship->getProperty(key);
-                if (!value.empty())
-                {
-                    if (!first)
-                    {
-                        cout << ",\n"; // Add comma for all but the first element
-                    }
-                    cout << "    \"" << key << "\": \"" << value << "\"";
-                    first = false;
-                }
-                else
+                out << "{\"error\": \"Malformed property pair '" << query.args[i] << "' - missing colon.\"}" << endl;
+                return;
+            }
+            if (predicates[i].key.empty() || predicates[i].text.empty())
+            {
+                out << "{\"error\": \"Empty key or value in property pair '" << query.args[i] << "'.\"}" << endl;
+                return;
+            }
+        }
+
+        findNodes(predicates);
+    }
+
+    void handleCreateIndex(const ParsedQuery &query)
+    {
+        if (query.argCount == 0)
+        {
+            out << "{\"error\": \"CREATE_INDEX query requires at least one property key.\"}" << endl;
+            return;
+        }
+        for (size_t i = 0; i < query.argCount; ++i)
+        {
+            if (query.args[i].empty())
+            {
+                out << "{\"error\": \"Malformed CREATE_INDEX query - empty key found.\"}" << endl;
+                return;
+            }
+        }
+        createPropertyIndex(argsFrom(query, 0));
+    }
+
+    void handleCreateColumns(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (query.argCount < 2)
+        {
+            out << "{\"error\": \"CREATE_COLUMNS query requires a label and at least one property key.\"}" << endl;
+            return;
+        }
+        createColumns(string(query.args[0]), argsFrom(query, 1));
+    }
+
+    void handleScan(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (query.argCount == 0)
+        {
+            out << "{\"error\": \"SCAN query requires a label.\"}" << endl;
+            return;
+        }
+
+        vector<PropertyPredicate> predicates(query.argCount - 1);
+        for (size_t i = 1; i < query.argCount; ++i)
+        {
+            PropertyPredicate &predicate = predicates[i - 1];
+            if (!parsePredicate(query.args[i], predicate) || predicate.key.empty() || predicate.text.empty())
+            {
+                out << "{\"error\": \"Malformed condition '" << query.args[i] << "' in SCAN query.\"}" << endl;
+                return;
+            }
+        }
+        scanLabel(string(query.args[0]), predicates);
+    }
+
+    void handleAggregate(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (query.argCount < 2)
+        {
+            out << "{\"error\": \"AGG query requires a label and at least one aggregate.\"}" << endl;
+            return;
+        }
+
+        vector<AggregateSpec> specs;
+        string groupKey;
+        for (size_t i = 1; i < query.argCount; ++i)
+        {
+            string_view name, inner;
+            AggregateSpec spec;
+            if (splitCall(query.args[i], name, inner) && name == "GROUP_BY" && groupKey.empty())
+            {
+                groupKey = string(inner);
+            }
+            else if (parseAggregate(query.args[i], spec))
+            {
+                specs.push_back(move(spec));
+            }
+            else
+            {
+                out << "{\"error\": \"Malformed aggregate '" << query.args[i] << "' in AGG query.\"}" << endl;
+                return;
+            }
+        }
+        aggregate(string(query.args[0]), specs, groupKey);
+    }
+
+    void handleCount(const ParsedQuery &query)
+    {
+        CountPattern pattern;
+        if (query.argCount != 1 || !parseCountPattern(query.args[0], pattern))
+        {
+            out << "{\"error\": \"COUNT query requires one label or one Label-[Relation]->Label pattern.\"}" << endl;
+            return;
+        }
+        countPattern(string(query.args[0]), pattern);
+    }
+
+    // Reads the arguments of PAGERANK, DEGREE and PAGERANK_STORE from `first` on: relation types
+    // (none or ALL for any type), "top:K" and "key:Name". Returns false on an empty or unknown option.
+    bool parseRankArguments(const ParsedQuery &query, size_t first, vector<Symbol> &relationSymbols, size_t &top, string &key)
+    {
+        for (size_t i = first; i < query.argCount; ++i)
+        {
+            string_view option, value;
+            if (!splitKeyValue(query.args[i], option, value))
+            {
+                if (query.args[i] != "ALL")
                 {
-                    cout << "    // Property \"" << key << "\" not found\n";
+                    relationSymbols.push_back(symbols.find(string(query.args[i])));
                 }
             }
-            cout << "\n  }\n";
-            cout << "}" << endl;
+            else if (option == "top" && parseCount(value, top))
+            {
+                continue;
+            }
+            else if (option == "key" && !value.empty())
+            {
+                key = string(value);
+            }
+            else
+            {
+                return false;
+            }
         }
+        return true;
     }
 
-    void deleteRelationshipProperty(const string &name1, const string &name2, const vector<string> &keys)
+    // Reads "iterations,damping" at the start of PAGERANK and PAGERANK_STORE
+    bool parseRankSettings(const ParsedQuery &query, size_t &iterations, double &damping)
     {
-        // Check if there are relationships for name1
-        if (relationships.find(name1) == relationships.end())
+        return query.argCount >= 2 && parseCount(query.args[0], iterations) && iterations > 0 &&
+               parseNumber(query.args[1], damping) && damping >= 0 && damping < 1;
+    }
+
+    void handlePageRank(const ParsedQuery &query)
+    {
+        size_t iterations, top = 10;
+        double damping;
+        vector<Symbol> relationSymbols;
+        string key;
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (!parseRankSettings(query, iterations, damping) || !parseRankArguments(query, 2, relationSymbols, top, key) || !key.empty())
         {
-            cout << "{\"error\": \"No relationships found for node \"" << name1 << "\".\"}" << endl;
+            out << "{\"error\": \"PAGERANK query requires a number of iterations, a damping factor below 1 and optionally relation types and top:K.\"}" << endl;
             return;
         }
+        pageRankTop(relationSymbols, iterations, damping, top);
+    }
 
-        // Get the set of relationships for name1
-        const auto &fromSet = relationships[name1];
+    void handleStorePageRank(const ParsedQuery &query)
+    {
+        size_t iterations, top = 0;
+        double damping;
+        vector<Symbol> relationSymbols;
+        string key = "PageRank";
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (!parseRankSettings(query, iterations, damping) || !parseRankArguments(query, 2, relationSymbols, top, key) || top != 0)
+        {
+            out << "{\"error\": \"PAGERANK_STORE query requires a number of iterations, a damping factor below 1 and optionally relation types and key:Name.\"}" << endl;
+            return;
+        }
+        storePageRank(relationSymbols, iterations, damping, key);
+    }
 
-        // Find the specific relationship to name2
-        auto it = std::find_if(fromSet.begin(), fromSet.end(), [&](const auto &relationshipPair)
-                               {
-                                   return relationshipPair.first == name2; // Match the second node
-                               });
+    void handleDegree(const ParsedQuery &query)
+    {
+        size_t top = 10;
+        vector<Symbol> relationSymbols;
+        string key;
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (!parseRankArguments(query, 0, relationSymbols, top, key) || !key.empty())
+        {
+            out << "{\"error\": \"DEGREE query takes optional relation types and top:K.\"}" << endl;
+            return;
+        }
+        degreeTop(relationSymbols, top);
+    }
 
-        // Check if the relationship exists
-        if (it == fromSet.end())
+    void handleComponentOf(const ParsedQuery &query)
+    {
+        if (query.argCount != 1 || query.args[0].empty())
         {
-            cout << "{\"error\": \"No relationship exists between \"" << name1 << "\" and \"" << name2 << "\".\"}" << endl;
+            out << "{\"error\": \"COMPONENT_OF query requires a node name.\"}" << endl;
             return;
         }
+        componentOf(string(query.args[0]));
+    }
 
-        // Retrieve the relationship object
-        Relationship *relationship = it->second; // Get the Relationship* from the found pair
-        if (!relationship)
+    void handleSameComponent(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (query.argCount != 2)
         {
-            cout << "{\"error\": \"Relationship object is null.\"}" << endl;
+            out << "{\"error\": \"SAME_COMPONENT query requires two node names.\"}" << endl;
             return;
         }
+        sameComponent(string(query.args[0]), string(query.args[1]));
+    }
 
-        // If "ALL" is the only key, clear all properties
-        if (keys.size() == 1 && keys[0] == "ALL")
+    void handleComponents(const ParsedQuery &query)
+    {
+        size_t minSize = 1;
+        if (query.argCount > 1 || (query.argCount == 1 && !query.args[0].empty() && !parseCount(query.args[0], minSize)))
         {
-            relationship->clearProperties();
-            cout << "{\"status\": \"success\", \"message\": \"All properties for the relationship between \"" << name1 << "\" and \"" << name2 << "\" have been cleared.\"}" << endl;
+            out << "{\"error\": \"COMPONENTS query takes an optional minimum size.\"}" << endl;
+            return;
         }
-        else
+        listComponents(minSize);
+    }
+
+    // Relation type arguments from `first` on; none or ALL stands for any type
+    vector<Symbol> relationArguments(const ParsedQuery &query, size_t first)
+    {
+        vector<Symbol> relationSymbols;
+        for (size_t i = first; i < query.argCount; ++i)
         {
-            // Otherwise, remove each specified property by key
-            for (const string &key : keys)
+            if (query.args[i] != "ALL")
             {
-                relationship->removeProperty(key);
-                cout << "{\"status\": \"success\", \"message\": \"Property \"" << key << "\" has been removed from the relationship between \""
-                     << name1 << "\" and \"" << name2 << "\".\"}" << endl;
+                relationSymbols.push_back(symbols.find(string(query.args[i])));
             }
         }
+        return relationSymbols;
     }
 
-    void retrieveRelatedNodes(const string &name, const vector<string> &relations)
+    void handleCommon(const ParsedQuery &query)
     {
-        // Check if the specified node exists in the graph
-        auto nodeIt = nodes.find(name);
-        if (nodeIt == nodes.end())
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (query.argCount < 2)
+        {
+            out << "{\"error\": \"COMMON query requires two node names.\"}" << endl;
+            return;
+        }
+        commonNeighbours(string(query.args[0]), string(query.args[1]), relationArguments(query, 2));
+    }
+
+    void handleTriangles(const ParsedQuery &query)
+    {
+        if (reportEmptyArgs(query, true))
+        {
+            return;
+        }
+        if (query.argCount == 0)
         {
-            cout << "{\"error\": \"Node with name \\\"" << name << "\\\" does not exist.\"}" << endl;
+            out << "{\"error\": \"TRIANGLES query requires a node name, or * for the whole graph.\"}" << endl;
             return;
         }
-
-        cout << "{\"related entities\": [";
-
-        // Iterate over the relationships associated with the specified node
-        auto relIt = relationships.find(name);
-        if (relIt != relationships.end())
+        if (query.args[0] == "*")
         {
-            bool found = false; // To track if any related nodes are printed
-            for (const auto &it : relIt->second)
-            {
-                // If ALL is specified, print all relationships
-                if (relations.empty() ||
-                    (relations.size() == 1 && relations[0] == "ALL") ||
-                    (std::find(relations.begin(), relations.end(), it.second->relation) != relations.end()))
-                {
-                    cout << "\n                      {\"name\": \"" << it.first << "\", \"relationship\": \"" << it.second->relation << "\"}, ";
-                    found = true;
-                }
-            }
-            if (found)
-            {
-                cout << "\b\b"; // Remove the last comma and space
-            }
-            else
-            {
-                cout << "{\"message\": \"No related nodes found for the specified relationship.\"}";
-            }
+            countTriangles(relationArguments(query, 1));
         }
         else
         {
-            cout << "{\"message\": \"No relationships found for this node.\"}";
+            nodeTriangles(string(query.args[0]), relationArguments(query, 1));
         }
-
-        cout << "\n                   ]\n}" << endl; // Closing JSON array and object
     }
 
-    void deleteNode(const string &label, const string &name)
+    void handleCreateRangeIndex(const ParsedQuery &query)
     {
-        // Step 1: Check if the node exists in the graph
-        auto nodeIt = nodes.find(name);
-        if (nodeIt == nodes.end())
+        if (query.argCount == 0)
         {
-            cout << "{\"error\": \"Node with name \"" << name << "\" not found.\"}" << endl;
+            out << "{\"error\": \"CREATE_RANGE_INDEX query requires at least one property key.\"}" << endl;
             return;
         }
-
-        // Step 2: Remove all outgoing relationships from this node
-        auto relIt = relationships.find(name);
-        if (relIt != relationships.end())
+        for (size_t i = 0; i < query.argCount; ++i)
         {
-            for (const auto &relationPair : relIt->second)
+            if (query.args[i].empty())
             {
-                // Find the related node's incoming relationship set and remove this node from it
-                auto &targetRelSet = relationships[relationPair.first];
-                targetRelSet.erase({name, relationPair.second});
-                delete relationPair.second; // Clean up the dynamically allocated Relationship object
+                out << "{\"error\": \"Malformed CREATE_RANGE_INDEX query - empty key found.\"}" << endl;
+                return;
             }
-            relationships.erase(relIt); // Erase all relationships from this node
         }
+        createRangeIndex(argsFrom(query, 0));
+    }
 
-        // Step 3: Remove all incoming relationships to this node
-        for (auto &relEntry : relationships)
+    void handleBulkLoad(const ParsedQuery &query)
+    {
+        if (query.argCount < 1 || query.argCount > 2 || (query.args[0].empty() && (query.argCount < 2 || query.args[1].empty())))
         {
-            auto &targetSet = relEntry.second;
-            for (auto it = targetSet.begin(); it != targetSet.end();)
-            {
-                if (it->first == name)
-                {
-                    delete it->second;        // Clean up the dynamically allocated Relationship object
-                    it = targetSet.erase(it); // Remove the relationship and move to the next element
-                }
-                else
-                {
-                    ++it;
-                }
-            }
+            out << "{\"error\": \"BULK_LOAD query requires a nodes file, an edges file, or both.\"}" << endl;
+            return;
         }
+        bulkLoad(string(query.args[0]), query.argCount > 1 ? string(query.args[1]) : string());
 
-        // Step 4: Remove the node from labelIndex
-        auto labelIt = labelIndex.find(label);
-        if (labelIt != labelIndex.end())
+        // Snapshot right away so that recovery never has to go back to the CSV files
+        if (!dataDirectory.empty() && !replaying && !writeCheckpoint())
         {
-            labelIt->second.erase(nodeIt->second); // Remove the node pointer from its label set
-
-            // If no nodes remain with this label, erase the label itself
-            if (labelIt->second.empty())
-            {
-                labelIndex.erase(labelIt);
-            }
+            out << "{\"error\": \"Checkpoint after BULK_LOAD failed.\"}" << endl;
         }
-
-        // Step 5: Remove the node from nodes map and delete it
-        delete nodeIt->second; // Clean up the dynamically allocated Node object
-        nodes.erase(nodeIt);
-
-        // JSON feedback indicating successful deletion
-        cout << "{\"status\": \"success\", \"message\": \"Node \"" << name << "\" and all associated relationships removed successfully.\"}" << endl;
     }
 
-    void deleteRelation(const string &name1, const string &name2, const string &relationType = "ALL")
+    void handleExportImage(const ParsedQuery &query)
     {
-        // Check if both nodes exist in the graph and if a relationship from name1 to name2 exists
-        auto node1It = relationships.find(name1);
-        if (node1It == relationships.end())
+        if (query.argCount != 1 || query.args[0].empty())
         {
-            cout << "{\"error\": \"Node \"" << name1 << "\" not found.\"}" << endl;
+            out << "{\"error\": \"EXPORT_IMAGE query requires the path of the image file.\"}" << endl;
             return;
         }
+        exportImage(string(query.args[0]));
+    }
 
-        auto &relSet = node1It->second;
-        bool relationshipFound = false;
-
-        // Iterate through relationships to find the specific relationship or all
-        for (auto it = relSet.begin(); it != relSet.end();)
-        {
-            if (it->first == name2)
-            {
-                Relationship *rel = it->second;
-
-                // Check if the relationship type matches or if "ALL" is specified
-                if (relationType == "ALL" || rel->relation == relationType)
-                {
-                    relationshipFound = true;
+    void handleCheckpoint(const ParsedQuery &)
+    {
+        checkpoint();
+    }
 
-                    // Clear relationship properties
-                    rel->properties.clear();
+    void handleMemoryStats(const ParsedQuery &)
+    {
+        getMemoryStats();
+    }
 
-                    // Delete the relationship itself
-                    delete rel;
+    void handleCacheStats(const ParsedQuery &)
+    {
+        lock_guard<mutex> lock(queryCacheMutex);
+        out << "{\"entries\": " << queryCache.size() << ", \"capacity\": " << queryCache.maxSize()
+            << ", \"hits\": " << cacheHits << ", \"misses\": " << cacheMisses
+            << ", \"evictions\": " << queryCache.evictions() << ", \"replans\": " << replans
+            << ", \"prepared\": " << preparedStatements.size() << "}" << endl;
+    }
 
-                    // Erase the relationship entry from the set
-                    it = relSet.erase(it);
-                }
-                else
-                {
-                    ++it;
-                }
-            }
-            else
-            {
-                ++it;
-            }
-        }
+    // Command keyword -> handler. Looking the keyword up replaces testing every command prefix in turn.
+    static const unordered_map<string_view, CommandInfo> &commandTable()
+    {
+        static const unordered_map<string_view, CommandInfo> table = {
+            {"ADD_ENTITY", {&Graph::handleAddEntity, Access::Write}},
+            {"ADD_PROPERTY", {&Graph::handleAddProperty, Access::Write}},
+            {"GET_INFO", {&Graph::handleGetInfo, Access::Read}},
+            {"DELETE_INFO", {&Graph::handleDeleteInfo, Access::Write}},
+            {"GET_LABELED", {&Graph::handleGetLabeled, Access::Read}},
+            {"ADD_r", {&Graph::handleAddRelationship, Access::Write}},
+            {"ADD_r_PROPERTY", {&Graph::handleAddRelationshipProperty, Access::Write}},
+            {"GET_r_INFO", {&Graph::handleGetRelationshipInfo, Access::Read}},
+            {"DELETE_r_INFO", {&Graph::handleDeleteRelationshipInfo, Access::Write}},
+            {"FIND", {&Graph::handleFind, Access::Read}},
+            {"FIND_IN", {&Graph::handleFindIncoming, Access::Read}},
+            {"EXPAND", {&Graph::handleExpand, Access::Read}},
+            {"EXPAND_STATS", {&Graph::handleExpandStats, Access::Read}},
+            {"PATH_EXISTS", {&Graph::handlePathExists, Access::Read}},
+            {"SHORTEST_PATH", {&Graph::handleShortestPath, Access::Read}},
+            {"MATCH", {&Graph::handleMatch, Access::Read}},
+            {"CACHE_STATS", {&Graph::handleCacheStats, Access::Read}},
+            {"DELETE_ENTITY", {&Graph::handleDeleteEntity, Access::Write}},
+            {"DELETE_r", {&Graph::handleDeleteRelationship, Access::Write}},
+            {"GET", {&Graph::handleGet, Access::Read}},
+            {"CREATE_INDEX", {&Graph::handleCreateIndex, Access::Write}},
+            {"CREATE_RANGE_INDEX", {&Graph::handleCreateRangeIndex, Access::Write}},
+            {"CREATE_COLUMNS", {&Graph::handleCreateColumns, Access::Write}},
+            {"SCAN", {&Graph::handleScan, Access::Read}},
+            {"AGG", {&Graph::handleAggregate, Access::Read}},
+            {"COUNT", {&Graph::handleCount, Access::Read}},
+            {"PAGERANK", {&Graph::handlePageRank, Access::Read}},
+            {"PAGERANK_STORE", {&Graph::handleStorePageRank, Access::Write}},
+            {"DEGREE", {&Graph::handleDegree, Access::Read}},
+            {"COMPONENT_OF", {&Graph::handleComponentOf, Access::Read}},
+            {"SAME_COMPONENT", {&Graph::handleSameComponent, Access::Read}},
+            {"COMPONENTS", {&Graph::handleComponents, Access::Read}},
+            {"COMMON", {&Graph::handleCommon, Access::Read}},
+            {"TRIANGLES", {&Graph::handleTriangles, Access::Read}},
+            {"BULK_LOAD", {&Graph::handleBulkLoad, Access::Write, true}},
+            {"CHECKPOINT", {&Graph::handleCheckpoint, Access::Exclusive}},
+            {"EXPORT_IMAGE", {&Graph::handleExportImage, Access::Read, true}},
+            {"MEMORY_STATS", {&Graph::handleMemoryStats, Access::Read}},
+        };
+        return table;
+    }
 
-        // If no relationship was found, print a message
-        if (!relationshipFound)
+public:
+    // True if the query only reads the graph, so it may run concurrently with other reads.
+    // Malformed and unknown queries count as reads: they only print an error. EXECUTE counts as
+    // its statement; PREPARE does not count, so statements exist before the queries after it run.
+    bool isReadQuery(const string &query)
+    {
+        if (trimView(query).substr(0, 8) == "PREPARE ")
         {
-            cout << "{\"error\": \"No matching relationship of type \"" << relationType
-                 << "\" found between \"" << name1 << "\" and \"" << name2 << "\".}" << endl;
-            return;
+            return false;
         }
-
-        // If name1 has no remaining relationships, remove it from relationships
-        if (relSet.empty())
+        ParsedQuery parsed;
+        parseQuery(query, parsed);
+        if (parsed.command.substr(0, 8) == "EXECUTE ")
         {
-            relationships.erase(name1);
+            lock_guard<mutex> lock(queryCacheMutex);
+            auto statement = preparedStatements.find(string(trimView(parsed.command.substr(8))));
+            return statement == preparedStatements.end() || statement->second->info->access == Access::Read;
         }
+        auto it = commandTable().find(parsed.command);
+        return it == commandTable().end() || it->second.access == Access::Read;
+    }
 
-        // Feedback for successful deletion
-        cout << "{\"status\": \"success\", \"message\": \"Relationship(s) between \""
-             << name1 << "\" and \"" << name2 << "\" of type \""
-             << relationType << "\" deleted successfully.\"}" << endl;
+    // Bounds the number of parsed queries the query cache keeps (--plan-cache)
+    void setQueryCacheCapacity(size_t capacity)
+    {
+        lock_guard<mutex> lock(queryCacheMutex);
+        queryCache.setCapacity(capacity);
     }
 
-    void findNodes(const vector<pair<string, string>> &keyvalue)
+    void interpretQuery(const string &query)
     {
-        // Error handling for empty keyvalue vector
-        if (keyvalue.empty())
+        if (trimView(query).substr(0, 8) == "PREPARE ")
         {
-            cout << "{\"error\": \"No properties specified for search.\"}" << endl;
+            prepareStatement(trimView(query));
             return;
         }
 
-        cout << "{\n";
-
-        bool firstPropertySection = true;
-        bool anyMatchesFound = false; // Track if any matches are found overall
-
-        // Iterate over each key-value pair to find matching nodes
-        for (const auto &kv : keyvalue)
+        // Tokenize once, then jump straight to the command's handler
+        ParsedQuery parsed;
+        ParseStatus status = parseQuery(query, parsed);
+        if (status == ParseStatus::Ok && parsed.command.substr(0, 8) == "EXECUTE ")
         {
-            const string &key = kv.first;
-            const string &value = kv.second;
+            executeStatement(parsed);
+            return;
+        }
 
-            // Collect all node names that match the current key-value pair
-            vector<string> matchingNodes;
-            for (const auto &nodeEntry : nodes)
-            {
-                Node *node = nodeEntry.second;
-                auto it = node->properties.find(key);
+        auto it = commandTable().find(parsed.command);
+        if (status == ParseStatus::MissingOpenBrace || it == commandTable().end())
+        {
+            out << "{\"error\": \"Invalid query format.\"}" << endl;
+            return;
+        }
+        if (status == ParseStatus::MissingCloseBrace)
+        {
+            out << "{\"error\": \"Malformed " << parsed.command << " query - missing closing brace.\"}" << endl;
+            return;
+        }
+        if (status == ParseStatus::TooManyArgs)
+        {
+            out << "{\"error\": \"Malformed " << parsed.command << " query - more than " << ParsedQuery::MaxArgs << " fields.\"}" << endl;
+            return;
+        }
 
-                // Check if the property exists and matches the value
-                if (it != node->properties.end() && it->second == value)
-                {
-                    matchingNodes.push_back(node->name);
-                }
-            }
+        const CommandInfo &command = it->second;
+        if (command.namesFiles && !fileCommandsAllowed)
+        {
+            out << "{\"error\": \"" << parsed.command << " is not available to socket clients.\"}" << endl;
+            return;
+        }
+        runCommand(command.access, trimView(query), [&]()
+                   { (this->*(command.handler))(parsed); });
+    }
+};
 
-            // If matches are found for this property, print them
-            if (!matchingNodes.empty())
-            {
-                anyMatchesFound = true;
-                if (!firstPropertySection)
-                {
-                    cout << ",\n"; // Add comma between different property sections
-                }
+// Read-only view of a graph image written by EXPORT_IMAGE. The file is mapped into memory and
+// queries are answered straight from the mapped pages: opening costs a few system calls no
+// matter how large the graph is, and replicas mapping the same file share its page cache.
+class GraphImage
+{
+    const char *base = nullptr;
+    size_t size = 0;
+    const ImageHeader *header = nullptr;
+#ifdef _WIN32
+    vector<char> contents; // Windows build reads the file instead of mapping it
+#endif
+
+    template <typename T>
+    const T *section(const ImageSection &section) const
+    {
+        return reinterpret_cast<const T *>(base + section.offset);
+    }
 
-                // Print property information
-                cout << "  \"property\":\"" << key << ":" << value << "\": {\n"
-                     << "    \"nodes\": [\n";
+    string_view text(const ImageString &reference) const
+    {
+        return string_view(base + header->strings.offset + reference.offset, reference.length);
+    }
 
-                // Print each node name under "nodes" array
-                for (size_t i = 0; i < matchingNodes.size(); ++i)
-                {
-                    cout << "      \"" << matchingNodes[i] << "\"";
-                    if (i < matchingNodes.size() - 1)
-                    {
-                        cout << ",";
-                    }
-                    cout << "\n";
-                }
+    string_view symbolName(Symbol symbol) const
+    {
+        return text(section<ImageString>(header->symbols)[symbol]);
+    }
 
-                cout << "    ]\n"
-                     << "  }";
-                firstPropertySection = false;
-            }
-        }
+    string_view nodeName(uint32_t node) const
+    {
+        return text(section<ImageNode>(header->nodes)[node].name);
+    }
 
-        // If no nodes matched any key-value pair, output a no matches message
-        if (!anyMatchesFound)
-        {
-            if (!firstPropertySection)
-            {
-                cout << ",\n";
-            }
-            cout << "  \"message\": \"No matching nodes found for specified properties.\"\n";
-        }
+    // Binary searches the name-sorted node table; returns InvalidNode if absent
+    uint32_t findNode(string_view name) const
+    {
+        const ImageNode *nodes = section<ImageNode>(header->nodes);
+        const ImageNode *end = nodes + header->nodes.count;
+        const ImageNode *it = lower_bound(nodes, end, name, [this](const ImageNode &node, string_view key)
+                                          { return text(node.name) < key; });
+        return it != end && text(it->name) == name ? static_cast<uint32_t>(it - nodes) : InvalidNode;
+    }
 
-        cout << "\n}\n";
+    Symbol findSymbol(string_view name) const
+    {
+        const Symbol *byName = section<Symbol>(header->symbolsByName);
+        const Symbol *end = byName + header->symbolsByName.count;
+        const Symbol *it = lower_bound(byName, end, name, [this](Symbol symbol, string_view key)
+                                       { return symbolName(symbol) < key; });
+        return it != end && symbolName(*it) == name ? *it : NoSymbol;
     }
 
-    void interpretQuery(const string &query)
+    // Checks that every section lies inside the file and, in one pass over the arrays, that every
+    // string, symbol, node, property, edge and label member reference stays inside its section,
+    // so a truncated, damaged or foreign file is refused instead of being read out of bounds
+    bool validate() const
     {
+        if (size < sizeof(ImageHeader) || memcmp(header->magic, "GDBIMG01", 8) != 0 || header->fileSize != size)
+        {
+            return false;
+        }
+        auto fits = [this](const ImageSection &section, size_t elementSize)
+        {
+            return section.offset % 8 == 0 && section.offset <= size &&
+                   section.count <= (size - section.offset) / elementSize;
+        };
+        if (!fits(header->strings, 1) || !fits(header->symbols, sizeof(ImageString)) ||
+            !fits(header->symbolsByName, sizeof(Symbol)) || !fits(header->nodes, sizeof(ImageNode)) ||
+            !fits(header->edgeOffsets, sizeof(uint64_t)) || header->edgeOffsets.count != header->nodes.count + 1 ||
+            !fits(header->edges, sizeof(ImageEdge)) || !fits(header->properties, sizeof(ImageProperty)) ||
+            !fits(header->labels, sizeof(ImageLabel)) || !fits(header->labelMembers, sizeof(uint32_t)))
+        {
+            return false;
+        }
 
-        // check for ADD_ENTITY query
-        if (query.find("ADD_ENTITY{") == 0)
+        // [first, first + count) within a section of `total` elements, without overflowing
+        auto inRange = [](uint64_t first, uint64_t count, uint64_t total)
         {
-            // Locate the opening and closing braces
-            int openBrace = query.find("{");
-            int closeBrace = query.find("}");
+            return first <= total && count <= total - first;
+        };
+        auto validString = [&](const ImageString &reference)
+        {
+            return inRange(reference.offset, reference.length, header->strings.count);
+        };
+        uint64_t symbolCount = header->symbols.count, nodeCount = header->nodes.count;
 
-            // Check for valid brace positions
-            if (openBrace == string::npos || closeBrace == string::npos || closeBrace < openBrace)
+        const ImageString *symbolStrings = section<ImageString>(header->symbols);
+        for (uint64_t i = 0; i < symbolCount; ++i)
+        {
+            if (!validString(symbolStrings[i]))
             {
-                cout << "{\"error\": \"Invalid query format.\"}" << endl;
-                return;
+                return false;
             }
-
-            // Extract the content inside the braces
-            string entityData = query.substr(openBrace + 1, closeBrace - openBrace - 1);
-
-            // Split the entity data by comma
-            int commaPos = entityData.find(",");
-            if (commaPos == string::npos)
+        }
+        const Symbol *byName = section<Symbol>(header->symbolsByName);
+        for (uint64_t i = 0; i < header->symbolsByName.count; ++i)
+        {
+            if (byName[i] >= symbolCount)
             {
-                cout << "{\"error\": \"Missing comma between label and name.\"}" << endl;
-                return;
+                return false;
             }
-
-            // Extract label and name
-            string label = entityData.substr(0, commaPos);
-            string name = entityData.substr(commaPos + 1);
-
-            // Trim any leading or trailing whitespace
-            label.erase(0, label.find_first_not_of(" \n\r\t")); // Trim left
-            label.erase(label.find_last_not_of(" \n\r\t") + 1); // Trim right
-            name.erase(0, name.find_first_not_of(" \n\r\t"));   // Trim left
-            name.erase(name.find_last_not_of(" \n\r\t") + 1);   // Trim right
-
-            // Call the method to add the node
-            addNode(label, name);
         }
-
-        // Check for ADD_PROPERTY query
-        else if (query.find("ADD_PROPERTY{") == 0)
+        const ImageNode *nodes = section<ImageNode>(header->nodes);
+        for (uint64_t i = 0; i < nodeCount; ++i)
         {
-            int openBrace = query.find("{");
-            int closeBrace = query.find("}");
-
-            if (openBrace == string::npos || closeBrace == string::npos || closeBrace < openBrace)
+            if (!validString(nodes[i].name) || nodes[i].label >= symbolCount ||
+                !inRange(nodes[i].firstProperty, nodes[i].propertyCount, header->properties.count))
             {
-                cout << "{\"error\": \"Malformed ADD_PROPERTY query - missing closing brace.\"}" << endl;
-                return;
+                return false;
             }
-
-            string propertyData = query.substr(openBrace + 1, closeBrace - openBrace - 1);
-            int commaPos = propertyData.find(",");
-
-            // Check for presence of a comma between name and properties
-            if (commaPos == string::npos)
+        }
+        const uint64_t *edgeOffsets = section<uint64_t>(header->edgeOffsets);
+        for (uint64_t i = 0; i < nodeCount; ++i)
+        {
+            if (edgeOffsets[i] > edgeOffsets[i + 1])
             {
-                cout << "{\"error\": \"Missing comma between name and properties.\"}" << endl;
-                return;
+                return false;
             }
-
-            // Extract the node name and properties
-            string name = propertyData.substr(0, commaPos);
-            string properties = propertyData.substr(commaPos + 1);
-
-            // Trim whitespace from name
-            name.erase(0, name.find_first_not_of(" \n\r\t"));
-            name.erase(name.find_last_not_of(" \n\r\t") + 1);
-
-            // Validate each property pair by checking for correct comma placement
-            stringstream ss(properties);
-            string keyValuePair;
-            bool errorFound = false;
-
-            while (getline(ss, keyValuePair, ','))
+        }
+        if (edgeOffsets[nodeCount] > header->edges.count)
+        {
+            return false;
+        }
+        const ImageEdge *edges = section<ImageEdge>(header->edges);
+        for (uint64_t e = 0; e < header->edges.count; ++e)
+        {
+            if (edges[e].target >= nodeCount || edges[e].relation >= symbolCount)
             {
-                int colonPos = keyValuePair.find(":");
-
-                // Check if each property has a colon separator and no missing commas
-                if (colonPos == string::npos || keyValuePair.find(",") == 0)
-                {
-                    cout << "{\"error\": \"Invalid property format - missing colon or comma between properties.\"}" << endl;
-                    errorFound = true;
-                    break;
-                }
-
-                string key = keyValuePair.substr(0, colonPos);
-                string value = keyValuePair.substr(colonPos + 1);
-
-                // Trim whitespace from key and value
-                key.erase(0, key.find_first_not_of(" \n\r\t"));
-                key.erase(key.find_last_not_of(" \n\r\t") + 1);
-                value.erase(0, value.find_first_not_of(" \n\r\t"));
-                value.erase(value.find_last_not_of(" \n\r\t") + 1);
-
-                // Add the property to the node if no errors
-                if (!errorFound)
-                    addNodeProperty(name, key, value);
+                return false;
             }
-
-            // If no errors, confirm success
-            if (!errorFound)
+        }
+        const ImageProperty *properties = section<ImageProperty>(header->properties);
+        for (uint64_t p = 0; p < header->properties.count; ++p)
+        {
+            if (!validString(properties[p].value) || properties[p].key >= symbolCount)
             {
-                cout << "{\"status\": \"success\", \"message\": \"Properties added to entity \""
-                     << name << "\" successfully.\"}" << endl;
+                return false;
             }
         }
-
-        // check for GET_INFO query
-        else if (query.find("GET_INFO{") == 0)
+        const ImageLabel *labels = section<ImageLabel>(header->labels);
+        for (uint64_t i = 0; i < header->labels.count; ++i)
         {
-            // Locate the opening and closing braces
-            int openBrace = query.find("{");
-            int closeBrace = query.find("}");
-
-            // Check for valid brace positions
-            if (openBrace == string::npos || closeBrace == string::npos || closeBrace < openBrace)
+            if (labels[i].label >= symbolCount || !inRange(labels[i].firstMember, labels[i].memberCount, header->labelMembers.count))
             {
-                cout << "{\"error\": \"Invalid query format.\"}" << endl;
-                return;
+                return false;
             }
-
-            int nameStart = query.find("{") + 1;
-            int nameEnd = query.find(",", nameStart);
-
-            if (nameEnd == string::npos)
+        }
+        const uint32_t *members = section<uint32_t>(header->labelMembers);
+        for (uint64_t i = 0; i < header->labelMembers.count; ++i)
+        {
+            if (members[i] >= nodeCount)
             {
-                cout << "{\"error\": \"Malformed GET_INFO query - missing comma after name.\"}" << endl;
-                return;
+                return false;
             }
+        }
+        return true;
+    }
 
-            // Extract and trim the `name`
-            string name = query.substr(nameStart, nameEnd - nameStart);
-            name.erase(0, name.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-            name.erase(name.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
-
-            // Extract and trim the `keys` string
-            string keysStr = query.substr(nameEnd + 1, query.find("}") - nameEnd - 1);
-            keysStr.erase(0, keysStr.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-            keysStr.erase(keysStr.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
+    void getNodeProperty(string_view name, const ParsedQuery &query) const
+    {
+        uint32_t index = findNode(name);
+        if (index == InvalidNode)
+        {
+            out << "{\"error\": \"Entity \"" << name << "\" does not exist in the database.\"}" << endl;
+            return;
+        }
+        const ImageNode &node = section<ImageNode>(header->nodes)[index];
+        const ImageProperty *properties = section<ImageProperty>(header->properties) + node.firstProperty;
 
-            if (name.empty() || keysStr.empty())
-            {
-                cout << "{\"error\": \"Malformed GET_INFO query - name or keys missing.\"}" << endl;
-                return;
-            }
+        out << "{" << endl;
+        out << "  \"Label\": \"" << symbolName(node.label) << "\"," << endl;
+        out << "  \"Name\": \"" << name << "\"," << endl;
+        out << "  \"Properties\": {" << endl;
 
-            vector<string> keys;
-            if (keysStr == "ALL")
-            {
-                keys.push_back("ALL");
-            }
-            else
+        // Same layouts as Node::printProperties (ALL) and Graph::getNodeProperty (listed keys)
+        if (query.argCount == 2 && query.args[1] == "ALL")
+        {
+            for (uint32_t i = 0; i < node.propertyCount; ++i)
             {
-                stringstream ss(keysStr);
-                string key;
-                while (getline(ss, key, ','))
+                out << "    \"" << symbolName(properties[i].key) << "\": \"" << text(properties[i].value) << "\"";
+                if (i + 1 < node.propertyCount)
                 {
-                    // Trim each key
-                    key.erase(0, key.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-                    key.erase(key.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
-
-                    if (key.empty())
-                    {
-                        cout << "{\"error\": \"Malformed GET_INFO query - empty key found.\"}" << endl;
-                        return;
-                    }
-                    keys.push_back(key);
+                    out << ",";
                 }
+                out << endl;
             }
-
-            // Retrieve properties in JSON format
-            getNodeProperty(name, keys);
+            out << "  }" << endl;
+            out << "}" << endl;
+            return;
         }
 
-        // check for DELETE_INFO query
-        else if (query.find("DELETE_INFO{") == 0)
+        for (size_t k = 1; k < query.argCount; ++k)
         {
-            // Parse DELETE_INFO query
-            int nameStart = query.find("{") + 1;
-            int nameEnd = query.find(",", nameStart);
-
-            if (nameEnd == string::npos)
+            if (k > 1)
             {
-                cout << "{\"error\": \"Malformed DELETE_INFO query - missing comma after name.\"}" << endl;
-                return;
+                out << ",\n";
             }
-
-            string name = query.substr(nameStart, nameEnd - nameStart);
-            string keysStr = query.substr(nameEnd + 1, query.find("}") - nameEnd - 1);
-
-            if (name.empty() || keysStr.empty())
+            Symbol key = findSymbol(query.args[k]);
+            const ImageProperty *property = properties;
+            const ImageProperty *end = properties + node.propertyCount;
+            while (property != end && property->key != key)
             {
-                cout << "{\"error\": \"Malformed DELETE_INFO query - name or keys missing.\"}" << endl;
-                return;
+                ++property;
             }
-
-            // Trim whitespace from name and keys
-            name.erase(remove_if(name.begin(), name.end(), ::isspace), name.end());
-            keysStr.erase(remove_if(keysStr.begin(), keysStr.end(), ::isspace), keysStr.end());
-
-            vector<string> keys;
-
-            if (keysStr == "ALL")
+            out << "    \"" << query.args[k] << "\": ";
+            if (property != end)
             {
-                keys.push_back("ALL");
+                out << "\"" << text(property->value) << "\"" << endl;
             }
             else
             {
-                stringstream ss(keysStr);
-                string key;
-                while (getline(ss, key, ','))
-                {
-                    if (key.empty())
-                    {
-                        cout << "{\"error\": \"Malformed DELETE_INFO query - empty key found.\"}" << endl;
-                        return;
-                    }
-                    keys.push_back(key);
-                }
+                out << "null" << endl;
             }
-
-            // Call the deleteNodeProperty function with the name and keys
-            deleteNodeProperty(name, keys);
         }
+        out << "\n  }\n";
+        out << "}" << endl;
+    }
 
-        // check for GET_LABELED query
-        else if (query.find("GET_LABELED{") == 0)
+    void getNodesByLabel(string_view label) const
+    {
+        Symbol symbol = findSymbol(label);
+        const ImageLabel *labels = section<ImageLabel>(header->labels);
+        const ImageLabel *end = labels + header->labels.count;
+        const ImageLabel *it = lower_bound(labels, end, symbol, [](const ImageLabel &entry, Symbol key)
+                                           { return entry.label < key; });
+        if (it == end || it->label != symbol)
         {
-            // Parse GET_LABELED query
-            int labelStart = query.find("{") + 1;       // Start after the opening brace
-            int labelEnd = query.find("}", labelStart); // Find the closing brace
-
-            // Check for malformed query
-            if (labelEnd == string::npos)
-            {
-                cout << "Error: Malformed GET_LABELED query - missing closing brace." << endl;
-                return;
-            }
-
-            // Extract the label
-            string label = query.substr(labelStart, labelEnd - labelStart);
-
-            // Trim whitespace
-            label.erase(0, label.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-            label.erase(label.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
+            out << "Error: Label \"" << label << "\" does not exist." << endl;
+            return;
+        }
 
-            // Check if the label is empty after trimming
-            if (label.empty())
+        out << "{" << endl;
+        out << "  \"label\": \"" << label << "\"," << endl;
+        out << "  \"entities\": [" << endl;
+        const uint32_t *members = section<uint32_t>(header->labelMembers) + it->firstMember;
+        for (uint64_t i = 0; i < it->memberCount; ++i)
+        {
+            out << "    \"" << nodeName(members[i]) << "\"";
+            if (i + 1 < it->memberCount)
             {
-                cout << "Error: Malformed GET_LABELED query - label is missing." << endl;
-                return;
+                out << ",";
             }
+            out << endl;
+        }
+        out << "  ]" << endl;
+        out << "}" << endl;
+    }
 
-            // Retrieve nodes by label and print them in JSON format
-            getNodesByLabel(label);
+    void retrieveRelatedNodes(const ParsedQuery &query) const
+    {
+        uint32_t index = findNode(query.args[0]);
+        if (index == InvalidNode)
+        {
+            out << "{\"error\": \"Node with name \\\"" << query.args[0] << "\\\" does not exist.\"}" << endl;
+            return;
         }
 
-        // check for ADD_r query
-        else if (query.find("ADD_r{") == 0)
+        bool allRelations = query.argCount == 1 || (query.argCount == 2 && query.args[1] == "ALL");
+        vector<Symbol> relationSymbols;
+        for (size_t i = 1; i < query.argCount; ++i)
         {
-            // Find the start and end of the curly braces
-            int startPos = query.find("{") + 1; // Position just after '{'
-            int endPos = query.find("}");
+            relationSymbols.push_back(findSymbol(query.args[i]));
+        }
 
-            // Check if curly braces are correctly placed
-            if (endPos == string::npos)
+        out << "{\"related entities\": [";
+        const uint64_t *edgeOffsets = section<uint64_t>(header->edgeOffsets);
+        const ImageEdge *edges = section<ImageEdge>(header->edges);
+        if (edgeOffsets[index] != edgeOffsets[index + 1])
+        {
+            bool found = false;
+            for (uint64_t e = edgeOffsets[index]; e < edgeOffsets[index + 1]; ++e)
             {
-                cout << "{\"error\": \"Malformed ADD_r query - missing closing brace.\"}" << endl;
-                return;
+                if (allRelations ||
+                    std::find(relationSymbols.begin(), relationSymbols.end(), edges[e].relation) != relationSymbols.end())
+                {
+                    out << "\n                      {\"name\": \"" << nodeName(edges[e].target) << "\", \"relationship\": \"" << symbolName(edges[e].relation) << "\"}, ";
+                    found = true;
+                }
+            }
+            if (found)
+            {
+                out << "\b\b"; // Remove the last comma and space
+            }
+            else
+            {
+                out << "{\"message\": \"No related nodes found for the specified relationship.\"}";
             }
+        }
+        else
+        {
+            out << "{\"message\": \"No relationships found for this node.\"}";
+        }
+        out << "\n                   ]\n}" << endl;
+    }
 
-            // Extract the content between the braces
-            string content = query.substr(startPos, endPos - startPos);
+public:
+    GraphImage() = default;
+    GraphImage(const GraphImage &) = delete;
+    GraphImage &operator=(const GraphImage &) = delete;
 
-            // Split the content by commas
-            stringstream ss(content);
-            string name1, name2, relation;
+    ~GraphImage()
+    {
+#ifndef _WIN32
+        if (base)
+        {
+            munmap(const_cast<char *>(base), size);
+        }
+#endif
+    }
 
-            // Extract Name1
-            getline(ss, name1, ',');
-            // Extract Name2
-            getline(ss, name2, ',');
-            // Extract Relation
-            getline(ss, relation, ',');
+    // Maps the image at `path`; returns false if it cannot be opened or is not a valid image
+    bool open(const string &path)
+    {
+#ifdef _WIN32
+        ifstream file(path, ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+        contents.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        base = contents.data();
+        size = contents.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        size = info.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping stays valid without the descriptor
+        if (mapped == MAP_FAILED)
+        {
+            return false;
+        }
+        base = static_cast<const char *>(mapped);
+#endif
+        header = reinterpret_cast<const ImageHeader *>(base);
+        return validate();
+    }
 
-            // Check for empty values and trim whitespace
-            if (name1.empty() || name2.empty() || relation.empty())
-            {
-                cout << "{\"error\": \"Malformed ADD_r query - one or more parameters are missing.\"}" << endl;
-                return;
-            }
+    uint64_t nodeCount() const
+    {
+        return header->nodes.count;
+    }
 
-            // Trim whitespace (if necessary)
-            name1.erase(0, name1.find_first_not_of(" \t\n\r"));       // Trim leading whitespace
-            name1.erase(name1.find_last_not_of(" \t\n\r") + 1);       // Trim trailing whitespace
-            name2.erase(0, name2.find_first_not_of(" \t\n\r"));       // Trim leading whitespace
-            name2.erase(name2.find_last_not_of(" \t\n\r") + 1);       // Trim trailing whitespace
-            relation.erase(0, relation.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-            relation.erase(relation.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
+    uint64_t relationshipCount() const
+    {
+        return header->edges.count;
+    }
 
-            // Call the function to add the relationship
-            addRelationship(name1, name2, relation);
+    // Answers FIND, GET_INFO and GET_LABELED with the same output as Graph; anything else is refused
+    void interpretQuery(const string &query) const
+    {
+        ParsedQuery parsed;
+        ParseStatus status = parseQuery(query, parsed);
+        if (status == ParseStatus::MissingOpenBrace)
+        {
+            out << "{\"error\": \"Invalid query format.\"}" << endl;
+            return;
         }
-
-        // check for ADD_r_PROPERTY query
-        else if (query.find("ADD_r_PROPERTY{") == 0)
+        if (parsed.command != "FIND" && parsed.command != "GET_INFO" && parsed.command != "GET_LABELED")
+        {
+            out << "{\"error\": \"" << parsed.command << " is not available on a read-only image.\"}" << endl;
+            return;
+        }
+        if (status == ParseStatus::MissingCloseBrace)
         {
-            // Extracting the main part of the query
-            int nameStart = query.find("{") + 1;
-            int nameEnd = query.find(",", nameStart);
+            out << "{\"error\": \"Malformed " << parsed.command << " query - missing closing brace.\"}" << endl;
+            return;
+        }
+        if (status == ParseStatus::TooManyArgs)
+        {
+            out << "{\"error\": \"Malformed " << parsed.command << " query - more than " << ParsedQuery::MaxArgs << " fields.\"}" << endl;
+            return;
+        }
 
-            if (nameEnd == string::npos)
+        if (parsed.command == "FIND")
+        {
+            if (reportEmptyArgs(parsed, true))
             {
-                cout << "Error: Malformed ADD_r_PROPERTY query - missing comma after Name1." << endl;
                 return;
             }
-
-            string name1 = query.substr(nameStart, nameEnd - nameStart);
-            int name2Start = nameEnd + 1;
-            int name2End = query.find(",", name2Start);
-
-            if (name2End == string::npos)
+            if (parsed.argCount < 1)
             {
-                cout << "Error: Malformed ADD_r_PROPERTY query - missing comma after Name2." << endl;
+                out << "{\"error\": \"FIND query requires at least a node name.\"}" << endl;
                 return;
             }
-
-            string name2 = query.substr(name2Start, name2End - name2Start);
-            string propertiesStr = query.substr(name2End + 1, query.find("}") - name2End - 1);
-
-            if (name1.empty() || name2.empty() || propertiesStr.empty())
+            retrieveRelatedNodes(parsed);
+        }
+        else if (parsed.command == "GET_INFO")
+        {
+            if (parsed.argCount < 2 || parsed.args[0].empty())
             {
-                cout << "Error: Malformed ADD_r_PROPERTY query - Name1, Name2, or properties missing." << endl;
+                out << "{\"error\": \"Malformed GET_INFO query - name or keys missing.\"}" << endl;
                 return;
             }
-
-            // Parsing key-value pairs
-            stringstream ss(propertiesStr);
-            string pair;
-            while (getline(ss, pair, ','))
+            for (size_t i = 1; i < parsed.argCount; ++i)
             {
-                int colonPos = pair.find(':');
-                if (colonPos == string::npos)
-                {
-                    cout << "Error: Malformed property pair \"" << pair << "\" - missing colon." << endl;
-                    return;
-                }
-
-                string key = pair.substr(0, colonPos);
-                string value = pair.substr(colonPos + 1);
-
-                // Remove extra whitespace from key and value
-                key.erase(0, key.find_first_not_of(" \t\n\r"));
-                key.erase(key.find_last_not_of(" \t\n\r") + 1);
-                value.erase(0, value.find_first_not_of(" \t\n\r"));
-                value.erase(value.find_last_not_of(" \t\n\r") + 1);
-
-                if (key.empty() || value.empty())
+                if (parsed.args[i].empty())
                 {
-                    cout << "Error: Empty key or value in property pair \"" << pair << "\"." << endl;
+                    out << "{\"error\": \"Malformed GET_INFO query - empty key found.\"}" << endl;
                     return;
                 }
-
-                // Add or update the relationship property
-                addRelationshipProperty(name1, name2, key, value);
             }
-            cout << "{\"status\": \"success\", \"message\": \"Properties added successfully.\"}" << endl;
+            getNodeProperty(parsed.args[0], parsed);
         }
-
-        // check for GET_r_INFO query
-        else if (query.find("GET_r_INFO{") == 0)
+        else
         {
-            // Parse the query to extract Name1, Name2, and keys
-            int start = query.find("{") + 1;
-            int end = query.find("}", start);
-            if (end == string::npos)
+            if (parsed.argCount < 1 || parsed.args[0].empty())
             {
-                cout << "Error: Malformed GET_r_INFO query - missing closing '}'." << endl;
+                out << "Error: Malformed GET_LABELED query - label is missing." << endl;
                 return;
             }
+            getNodesByLabel(parsed.args[0]);
+        }
+    }
+};
+
+#ifdef __linux__
+// Set by SIGINT / SIGTERM so the server loop can stop and let main() exit cleanly
+volatile sig_atomic_t stopRequested = 0;
+
+// Serves the query language over a TCP or Unix-domain socket. Clients send queries as lines
+// and may send many before reading any answer (pipelining). Each query gets one response frame,
+// "<length>\n<payload>", where the payload is exactly what the stdin front end prints for it,
+// and frames come back in the order the connection sent its queries. A single epoll loop does
+// all socket I/O. The queries that arrive in one wakeup, from every connection, are answered
+// together as one batch, so reads from different clients run in parallel under --threads.
+class SocketServer
+{
+public:
+    using BatchHandler = function<void(const vector<string> &queries, vector<string> &responses)>;
 
-            string content = query.substr(start, end - start);
+private:
+    struct Connection
+    {
+        string input;          // Received bytes after the last complete line
+        string output;         // Framed responses not sent yet
+        size_t sent = 0;       // Bytes of `output` already sent
+        bool closing = false;  // The peer stopped sending (or sent `end`); close once output is sent
+        uint32_t events = 0;   // Events currently registered with epoll
+    };
+
+    static const size_t ReadChunk = 64 * 1024;
+    static const size_t MaxLineLength = 1 << 20;    // A longer line closes the connection
+    static const size_t MaxPendingOutput = 8 << 20; // Stop reading from clients that do not read their answers
+
+    int listenFd = -1;
+    int epollFd = -1;
+    string unixPath;
+    unordered_map<int, Connection> connections;
+    vector<char> readBuffer = vector<char>(ReadChunk);
+
+    void closeConnection(int fd)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
+    }
 
-            // Find the first comma, which separates Name1 and Name2
-            int commaPos1 = content.find(",");
-            if (commaPos1 == string::npos)
+    void acceptClients()
+    {
+        while (true)
+        {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
             {
-                cout << "Error: Malformed GET_r_INFO query - missing first comma." << endl;
-                return;
+                return; // EAGAIN: no more pending connections
             }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Fails harmlessly on Unix sockets
+
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+            connections[fd].events = EPOLLIN;
+        }
+    }
 
-            string name1 = content.substr(0, commaPos1);
-            name1.erase(0, name1.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-            name1.erase(name1.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
-
-            // Find the second comma, which separates Name2 and the keys or "ALL"
-            int commaPos2 = content.find(",", commaPos1 + 1);
-            if (commaPos2 == string::npos)
+    // Reads what the socket has and queues every complete line as a query owned by `fd`.
+    // Returns false if the connection failed and has been closed.
+    bool readFrom(int fd, Connection &connection, vector<string> &queries, vector<int> &owners)
+    {
+        ssize_t received = recv(fd, readBuffer.data(), readBuffer.size(), 0);
+        if (received < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
             {
-                cout << "Error: Malformed GET_r_INFO query - missing second comma." << endl;
-                return;
+                return true;
             }
+            closeConnection(fd);
+            return false;
+        }
+        if (received == 0)
+        {
+            connection.closing = true; // Still answer the lines already received
+        }
+        connection.input.append(readBuffer.data(), received);
 
-            string name2 = content.substr(commaPos1 + 1, commaPos2 - commaPos1 - 1);
-            name2.erase(0, name2.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-            name2.erase(name2.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
-
-            // Extract keys or "ALL"
-            string keysStr = content.substr(commaPos2 + 1);
-            keysStr.erase(0, keysStr.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-            keysStr.erase(keysStr.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
-
-            vector<string> keys;
-            if (keysStr == "ALL")
+        size_t start = 0, newline;
+        while ((newline = connection.input.find('\n', start)) != string::npos)
+        {
+            string_view line(connection.input.data() + start, newline - start);
+            start = newline + 1;
+            if (!line.empty() && line.back() == '\r')
             {
-                keys.push_back("ALL");
+                line.remove_suffix(1);
             }
-            else
+            if (line == "end")
             {
-                stringstream ss(keysStr);
-                string key;
-                while (getline(ss, key, ','))
-                {
-                    key.erase(0, key.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-                    key.erase(key.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
-                    if (!key.empty())
-                    {
-                        keys.push_back(key);
-                    }
-                    else
-                    {
-                        cout << "Error: Malformed GET_r_INFO query - empty key found." << endl;
-                        return;
-                    }
-                }
+                connection.closing = true;
+                start = connection.input.size();
+                break;
             }
-
-            // Retrieve relationship properties
-            getRelationshipProperty(name1, name2, keys);
+            queries.emplace_back(line);
+            owners.push_back(fd);
         }
+        connection.input.erase(0, start);
 
-        // check for DELETE_r_INFO query
-        else if (query.find("DELETE_r_INFO{") == 0)
+        if (connection.input.size() > MaxLineLength)
         {
-            // Extract the content between the curly braces
-            int start = query.find("{") + 1;
-            int end = query.find("}", start);
-            if (end == string::npos)
-            {
-                cout << "Error: Malformed DELETE_r_INFO query - missing closing brace." << endl;
-                return;
-            }
-
-            string content = query.substr(start, end - start);
+            connection.closing = true;
+            connection.input.clear();
+        }
+        return true;
+    }
 
-            // Split content by commas to separate name1, name2, and keys
-            stringstream ss(content);
-            string item;
-            vector<string> parts;
-            while (getline(ss, item, ','))
+    // Sends as much pending output as the socket accepts. Returns false if the connection failed
+    // and has been closed.
+    bool sendPending(int fd, Connection &connection)
+    {
+        while (connection.sent < connection.output.size())
+        {
+            ssize_t written = send(fd, connection.output.data() + connection.sent,
+                                   connection.output.size() - connection.sent, MSG_NOSIGNAL);
+            if (written < 0)
             {
-                // Trim whitespace around each item
-                item.erase(0, item.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-                item.erase(item.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
-                if (item.empty())
+                if (errno == EINTR)
                 {
-                    cout << "Error: Malformed DELETE_r_INFO query - empty fields found." << endl;
-                    return;
+                    continue;
                 }
-                parts.push_back(item);
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    break;
+                }
+                closeConnection(fd);
+                return false;
             }
+            connection.sent += written;
+        }
 
-            // Validate that we have at least 3 parts: name1, name2, and one key or "ALL"
-            if (parts.size() < 3)
-            {
-                cout << "Error: DELETE_r_INFO query requires at least a source node, target node, and at least one key or 'ALL'." << endl;
-                return;
-            }
+        if (connection.sent == connection.output.size())
+        {
+            connection.output.clear();
+            connection.sent = 0;
+        }
+        else if (connection.sent > connection.output.size() / 2)
+        {
+            connection.output.erase(0, connection.sent);
+            connection.sent = 0;
+        }
+        return true;
+    }
+
+    // Flushes a connection and re-registers the events it now waits for, closing it when done
+    void update(int fd)
+    {
+        auto it = connections.find(fd);
+        if (it == connections.end() || !sendPending(fd, it->second))
+        {
+            return;
+        }
+        Connection &connection = it->second;
+        size_t pending = connection.output.size() - connection.sent;
+        if (connection.closing && pending == 0)
+        {
+            closeConnection(fd);
+            return;
+        }
 
-            // Extract name1 and name2
-            string name1 = parts[0];
-            string name2 = parts[1];
+        uint32_t events = 0;
+        if (!connection.closing && pending < MaxPendingOutput)
+        {
+            events |= EPOLLIN;
+        }
+        if (pending > 0)
+        {
+            events |= EPOLLOUT;
+        }
+        if (events != connection.events)
+        {
+            epoll_event event = {};
+            event.events = events;
+            event.data.fd = fd;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+            connection.events = events;
+        }
+    }
 
-            // Collect keys (or check if it's "ALL")
-            vector<string> keys(parts.begin() + 2, parts.end());
+public:
+    SocketServer() = default;
+    SocketServer(const SocketServer &) = delete;
+    SocketServer &operator=(const SocketServer &) = delete;
 
-            // Call deleteRelationshipProperty with parsed values
-            deleteRelationshipProperty(name1, name2, keys);
+    ~SocketServer()
+    {
+        for (auto &entry : connections)
+        {
+            ::close(entry.first);
+        }
+        if (listenFd >= 0)
+        {
+            ::close(listenFd);
+        }
+        if (epollFd >= 0)
+        {
+            ::close(epollFd);
+        }
+        if (!unixPath.empty())
+        {
+            unlink(unixPath.c_str());
         }
+    }
 
-        // check for FIND query
-        else if (query.find("FIND{") == 0)
+    // Binds `address`: "unix:PATH" for a Unix-domain socket, otherwise "[host:]port" for TCP
+    // (host defaults to 127.0.0.1, so the server is not reachable from other machines by accident)
+    bool listen(const string &address)
+    {
+        if (address.rfind("unix:", 0) == 0)
         {
-            // Extract the content between the curly braces
-            int start = query.find("{") + 1;
-            int end = query.find("}", start);
-            if (end == string::npos)
+            sockaddr_un local = {};
+            local.sun_family = AF_UNIX;
+            string path = address.substr(5);
+            if (path.empty() || path.size() >= sizeof(local.sun_path))
             {
-                cout << "{\"error\": \"Malformed FIND query - missing closing brace.\"}" << endl;
-                return;
+                return false;
             }
+            memcpy(local.sun_path, path.c_str(), path.size() + 1);
 
-            string content = query.substr(start, end - start);
-
-            // Split content by commas to separate name and relations
-            stringstream ss(content);
-            string item;
-            vector<string> parts;
-            while (getline(ss, item, ','))
+            listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            unlink(path.c_str()); // Left behind by a previous run
+            if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0)
             {
-                // Trim whitespace around each item
-                item.erase(0, item.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-                item.erase(item.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
-                if (item.empty())
-                {
-                    cout << "{\"error\": \"Malformed FIND query - empty fields found.\"}" << endl;
-                    return;
-                }
-                parts.push_back(item);
+                return false;
             }
-
-            // Ensure we have at least a node name
-            if (parts.size() < 1)
+            unixPath = path;
+        }
+        else
+        {
+            size_t colon = address.rfind(':');
+            string host = colon == string::npos || colon == 0 ? "127.0.0.1" : address.substr(0, colon);
+            string port = colon == string::npos ? address : address.substr(colon + 1);
+
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = AI_PASSIVE;
+            addrinfo *result = nullptr;
+            if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
             {
-                cout << "{\"error\": \"FIND query requires at least a node name.\"}" << endl;
-                return;
+                return false;
             }
-
-            // Extract the name
-            string name = parts[0];
-
-            // Collect relationships or check if it's "ALL"
-            vector<string> relations(parts.begin() + 1, parts.end());
-
-            // Handle "ALL" keyword
-            if (relations.size() == 1 && relations[0] == "ALL")
+            listenFd = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int one = 1;
+            bool bound = listenFd >= 0 &&
+                         setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0 &&
+                         bind(listenFd, result->ai_addr, result->ai_addrlen) == 0;
+            freeaddrinfo(result);
+            if (!bound)
             {
-                relations.clear(); // Clear to indicate all relationships
+                return false;
             }
-
-            // Call retrieveRelatedNodes with parsed values
-            retrieveRelatedNodes(name, relations);
         }
 
-        // check for DELETE_ENTITY query
-        else if (query.find("DELETE_ENTITY{") == 0)
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = listenFd;
+        return ::listen(listenFd, SOMAXCONN) == 0 && epollFd >= 0 &&
+               epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+    }
+
+    // Runs until SIGINT or SIGTERM
+    void run(const BatchHandler &answerBatch)
+    {
+        struct sigaction action = {};
+        action.sa_handler = [](int)
+        { stopRequested = 1; };
+        sigaction(SIGINT, &action, nullptr); // No SA_RESTART, so epoll_wait returns at once
+        sigaction(SIGTERM, &action, nullptr);
+
+        vector<epoll_event> events(256);
+        vector<string> queries, responses;
+        vector<int> owners, touched;
+        while (!stopRequested)
         {
-            // Extract the content between the curly braces
-            int start = query.find("{") + 1;
-            int end = query.find("}", start);
-            if (end == string::npos)
+            int ready = epoll_wait(epollFd, events.data(), events.size(), -1);
+            if (ready < 0)
             {
-                cout << "{\"error\": \"Malformed DELETE_ENTITY query - missing closing brace.\"}" << endl;
-                return;
+                continue; // EINTR: check for a stop request
             }
 
-            string content = query.substr(start, end - start);
-
-            // Split content by commas to separate label and name
-            stringstream ss(content);
-            string item;
-            vector<string> parts;
-            while (getline(ss, item, ','))
+            queries.clear();
+            owners.clear();
+            touched.clear();
+            for (int i = 0; i < ready; ++i)
             {
-                // Trim whitespace around each item
-                item.erase(0, item.find_first_not_of(" \t\n\r")); // Trim leading whitespace
-                item.erase(item.find_last_not_of(" \t\n\r") + 1); // Trim trailing whitespace
-                if (item.empty())
+                int fd = events[i].data.fd;
+                if (fd == listenFd)
                 {
-                    cout << "{\"error\": \"Malformed DELETE_ENTITY query - empty fields found.\"}" << endl;
-                    return;
+                    acceptClients();
+                    continue;
+                }
+                auto it = connections.find(fd);
+                if (it == connections.end())
+                {
+                    continue;
+                }
+                if (events[i].events & EPOLLERR)
+                {
+                    closeConnection(fd);
+                    continue;
+                }
+                if ((events[i].events & (EPOLLIN | EPOLLHUP)) && !it->second.closing)
+                {
+                    if (!readFrom(fd, it->second, queries, owners))
+                    {
+                        continue;
+                    }
+                }
+                else if (events[i].events & EPOLLHUP)
+                {
+                    closeConnection(fd); // Peer is gone; its pending answers cannot be delivered
+                    continue;
                 }
-                parts.push_back(item);
+                touched.push_back(fd);
             }
 
-            // Ensure we have both a label and name
-            if (parts.size() < 2)
+            // Answer everything that arrived in this wakeup, then frame each response back to
+            // the connection that asked
+            if (!queries.empty())
             {
-                cout << "{\"error\": \"DELETE_ENTITY query requires both a label and a name.\"}" << endl;
-                return;
+                answerBatch(queries, responses);
+                char length[24];
+                for (size_t i = 0; i < queries.size(); ++i)
+                {
+                    Connection &connection = connections[owners[i]];
+                    auto result = to_chars(length, length + sizeof(length), responses[i].size());
+                    *result.ptr++ = '\n';
+                    connection.output.append(length, result.ptr - length);
+                    connection.output += responses[i];
+                }
+            }
+            for (int fd : touched)
+            {
+                update(fd);
             }
-
-            // Extract the label and name
-            string label = parts[0];
-            string name = parts[1];
-
-            // Call deleteNode with parsed values
-            deleteNode(label, name);
         }
+    }
+};
+#endif
 
-        // check for DELETE_r query
-        else if (query.find("DELETE_r{") == 0)
+#ifndef DATABASE_NO_MAIN // Benchmark.cpp includes this file and brings its own main()
+int main(int argc, char *argv[])
+{
+    // --interactive flushes the response of every query right away (the old behaviour)
+    // --load nodes.csv [edges.csv] bulk loads CSV files before reading any query
+    // --data-dir DIR keeps a write-ahead log and snapshots in DIR and recovers from them at startup
+    // --fsync-every N syncs the log every N mutating queries (default 1, 0 = leave it to the OS)
+    // --checkpoint-every N writes a snapshot every N mutating queries (default 0 = only on CHECKPOINT{})
+    // --image FILE serves FIND / GET_INFO / GET_LABELED read-only from an image written by EXPORT_IMAGE
+    // --threads N answers consecutive read queries on N threads at once (default 1)
+    // --listen [host:]port or --listen unix:PATH serves clients over a socket instead of stdin
+    // --plan-cache N keeps at most N parsed MATCH / PREPARE queries (default 1024)
+    string listenAddress;
+    bool interactive = false;
+    size_t threadCount = 1;
+    string loadNodes, loadEdges, dataDirectory, imagePath;
+    bool load = false;
+    size_t fsyncEvery = 1, checkpointEvery = 0;
+    size_t planCacheSize = 1024;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--interactive")
+        {
+            interactive = true;
+        }
+        else if (arg == "--listen" && i + 1 < argc)
+        {
+            listenAddress = argv[++i];
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            threadCount = max<size_t>(1, stoul(argv[++i]));
+        }
+        else if (arg == "--image" && i + 1 < argc)
+        {
+            imagePath = argv[++i];
+        }
+        else if (arg == "--data-dir" && i + 1 < argc)
+        {
+            dataDirectory = argv[++i];
+        }
+        else if (arg == "--fsync-every" && i + 1 < argc)
+        {
+            fsyncEvery = stoul(argv[++i]);
+        }
+        else if (arg == "--checkpoint-every" && i + 1 < argc)
+        {
+            checkpointEvery = stoul(argv[++i]);
+        }
+        else if (arg == "--plan-cache" && i + 1 < argc)
+        {
+            planCacheSize = stoul(argv[++i]);
+        }
+        else if (arg == "--load" && i + 1 < argc)
         {
-            // Extract the content between the curly braces
-            int start = query.find("{") + 1;
-            int end = query.find("}", start);
-            if (end == string::npos)
+            load = true;
+            loadNodes = argv[++i];
+            if (i + 1 < argc && string(argv[i + 1]).rfind("--", 0) != 0)
             {
-                cout << "{\"error\": \"Malformed DELETE_r query - missing closing brace.\"}" << endl;
-                return;
+                loadEdges = argv[++i];
             }
+        }
+    }
 
-            string content = query.substr(start, end - start);
+    // Without stdio sync, cin reads ahead in blocks and in_avail() tells whether more input is already waiting
+    ios::sync_with_stdio(false);
+
+    GraphImage image;
+    bool useImage = !imagePath.empty();
+    if (useImage)
+    {
+        if (!image.open(imagePath))
+        {
+            out << "{\"error\": \"'" << imagePath << "' is not a readable graph image.\"}" << endl;
+            out.flush();
+            return 1;
+        }
+        out << "{\"status\": \"success\", \"message\": \"Mapped image with " << image.nodeCount() << " entities and "
+            << image.relationshipCount() << " relationships (read-only).\"}" << endl;
+        out.flush();
+    }
 
-            // Split content by commas to separate name1, name2, and relationship type (or "ALL")
-            stringstream ss(content);
-            string item;
-            vector<string> parts;
-            while (getline(ss, item, ','))
+    Graph g;
+    g.setQueryCacheCapacity(planCacheSize);
+    if (!dataDirectory.empty() && !g.openStorage(dataDirectory, fsyncEvery, checkpointEvery))
+    {
+        out.flush();
+        return 1;
+    }
+    if (load)
+    {
+        // Goes through the query path so that it is logged like BULK_LOAD{...}
+        g.interpretQuery("BULK_LOAD{" + loadNodes + "," + loadEdges + "}");
+        out.flush();
+    }
+    // Answers a batch of queries, one response per query. Each run of consecutive read queries is
+    // spread over the worker pool, while writes run one at a time in their original position, so
+    // the result is the same as answering the queries one by one.
+    WorkerPool pool(threadCount - 1);
+    if (threadCount > 1)
+    {
+        g.setWorkerPool(&pool);
+    }
+    auto answerBatch = [&](const vector<string> &batch, vector<string> &responses)
+    {
+        responses.assign(batch.size(), string());
+        auto answer = [&](size_t i)
+        {
+            out.capture(&responses[i]);
+            if (useImage)
             {
-                // Trim whitespace around each item
-                item.erase(0, item.find_first_not_of(" \t\n\r"));
-                item.erase(item.find_last_not_of(" \t\n\r") + 1);
-                if (item.empty())
-                {
-                    cout << "{\"error\": \"Malformed DELETE_r query - empty fields found.\"}" << endl;
-                    return;
-                }
-                parts.push_back(item);
+                image.interpretQuery(batch[i]);
             }
-
-            // Validate that we have exactly 3 parts: name1, name2, and relationship type (or "ALL")
-            if (parts.size() != 3)
+            else
             {
-                cout << "{\"error\": \"DELETE_r query requires exactly two node names and a relationship type (or 'ALL').\"}" << endl;
-                return;
+                g.interpretQuery(batch[i]);
             }
+            out.capture(nullptr);
+        };
 
-            // Extract name1, name2, and relation type
-            string name1 = parts[0];
-            string name2 = parts[1];
-            string relationType = parts[2];
-
-            // Call deleteRelation with parsed values
-            deleteRelation(name1, name2, relationType);
-        }
-
-        else if (query.find("GET{") == 0)
+        for (size_t first = 0; first < batch.size();)
         {
-            // Extract the main part of the query inside `{ }`
-            int queryStart = query.find("{") + 1;
-            int queryEnd = query.find("}", queryStart);
-
-            if (queryEnd == string::npos)
+            size_t last = first;
+            while (pool.size() > 1 && last < batch.size() && (useImage || g.isReadQuery(batch[last])))
             {
-                cout << "{\"error\": \"Malformed GET query - missing closing brace.\"}" << endl;
-                return;
+                ++last;
             }
-
-            string propertiesStr = query.substr(queryStart, queryEnd - queryStart);
-
-            // If the properties string is empty, return an error
-            if (propertiesStr.empty())
+            if (last - first < 2)
             {
-                cout << "{\"error\": \"Malformed GET query - properties section is empty.\"}" << endl;
-                return;
+                answer(first);
+                first = max(first + 1, last);
+                continue;
             }
+            pool.parallelFor(last - first, [&](size_t i)
+                             { answer(first + i); });
+            first = last;
+        }
 
-            // Parse key-value pairs from propertiesStr
-            stringstream ss(propertiesStr);
-            string keyValuePair;
-            vector<pair<string, string>> keyvalue; // To store parsed key-value pairs
+        // The changes must be durable before any response acknowledges them
+        if (!g.syncLog() && !responses.empty())
+        {
+            responses.back() += "{\"error\": \"Cannot sync the write-ahead log; changes in this batch may not survive a restart.\"}\n";
+        }
+    };
 
-            while (getline(ss, keyValuePair, ','))
+    vector<string> batch, responses;
+    if (!listenAddress.empty())
+    {
+#ifdef __linux__
+        SocketServer server;
+        if (!server.listen(listenAddress))
+        {
+            out << "{\"error\": \"Cannot listen on '" << listenAddress << "'.\"}" << endl;
+            out.flush();
+            return 1;
+        }
+        out << "{\"status\": \"success\", \"message\": \"Listening on " << listenAddress << ".\"}" << endl;
+        out.flush();
+        g.allowFileCommands(false); // --load has run already; clients may not name server-side files
+        server.run(answerBatch);
+#else
+        out << "{\"error\": \"--listen is only supported on Linux.\"}" << endl;
+        out.flush();
+        return 1;
+#endif
+    }
+    else
+    {
+        // Queries are read in batches: everything that has already arrived, up to MaxBatch lines
+        // (one line at a time in --interactive mode), and the answers are flushed once per batch.
+        const size_t MaxBatch = 4096;
+        bool more = true;
+        while (more)
+        {
+            batch.clear();
+            string query;
+            while (getline(cin, query))
             {
-                int colonPos = keyValuePair.find(':');
-                if (colonPos == string::npos)
+                if (query == "end")
                 {
-                    cout << "{\"error\": \"Malformed property pair '" << keyValuePair << "' - missing colon.\"}" << endl;
-                    return;
+                    more = false;
+                    break;
                 }
-
-                // Extract key and value, and trim whitespace
-                string key = keyValuePair.substr(0, colonPos);
-                string value = keyValuePair.substr(colonPos + 1);
-                key.erase(0, key.find_first_not_of(" \t\n\r"));
-                key.erase(key.find_last_not_of(" \t\n\r") + 1);
-                value.erase(0, value.find_first_not_of(" \t\n\r"));
-                value.erase(value.find_last_not_of(" \t\n\r") + 1);
-
-                if (key.empty() || value.empty())
+                batch.push_back(move(query));
+                if (interactive || batch.size() >= MaxBatch || cin.rdbuf()->in_avail() <= 0)
                 {
-                    cout << "{\"error\": \"Empty key or value in property pair '" << keyValuePair << "'.\"}" << endl;
-                    return;
+                    break;
                 }
-
-                keyvalue.push_back({key, value});
+            }
+            if (!cin)
+            {
+                more = false;
             }
 
-            // Call findNodes with the parsed key-value pairs
-            findNodes(keyvalue);
-        }
-
-        else
-        {
-            cout << "{\"error\": \"Invalid query format.\"}" << endl;
+            answerBatch(batch, responses);
+            for (const string &response : responses)
+            {
+                out << response;
+            }
+            out.flush();
         }
     }
-};
-
-int main()
-{
-    Graph g;
 
-    while (true)
+    if (!g.syncLog())
     {
-
-        string query;
-        getline(cin, query);
-
-        if (query == "end")
-        {
-            break;
-        }
-        else
-        {
-            g.interpretQuery(query);
-        }
+        out << "{\"error\": \"Cannot sync the write-ahead log; the last changes may not survive a restart.\"}" << endl;
     }
-
+    out.flush();
     return 0;
 }
+#endif
@@ -0,0 +1,72 @@
+import socket
+import sys
+import threading
+
+# Command line client for a Database started with --listen.
+#
+#   python3 client.py 7687 < Example_input.txt
+#   python3 client.py unix:/tmp/graph.sock "FIND{John_Doe,ALL}" "GET_LABELED{Person}"
+#
+# Queries come from the remaining arguments, or from standard input when there are none. They are
+# all sent at once (pipelined) and the responses are printed in order as their frames arrive.
+# Each response frame is "<length>\n<payload>".
+
+def connect(address):
+    if address.startswith("unix:"):
+        client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        client.connect(address[5:])
+        return client
+
+    host, _, port = address.rpartition(":")
+    client = socket.create_connection((host or "127.0.0.1", int(port)))
+    client.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    return client
+
+class FrameReader:
+    def __init__(self, client):
+        self.client = client
+        self.buffer = b""
+
+    def read_frame(self):
+        # Length line first, then exactly that many payload bytes
+        while b"\n" not in self.buffer:
+            self.fill()
+        length, _, self.buffer = self.buffer.partition(b"\n")
+        length = int(length)
+        while len(self.buffer) < length:
+            self.fill()
+        payload, self.buffer = self.buffer[:length], self.buffer[length:]
+        return payload.decode()
+
+    def fill(self):
+        data = self.client.recv(65536)
+        if not data:
+            raise ConnectionError("server closed the connection")
+        self.buffer += data
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: client.py [host:]port|unix:PATH [QUERY...]", file=sys.stderr)
+        return 1
+
+    queries = sys.argv[2:] or [line.rstrip("\r\n") for line in sys.stdin]
+
+    # Like the stdin front end, "end" finishes the session
+    if "end" in queries:
+        queries = queries[:queries.index("end")]
+
+    client = connect(sys.argv[1])
+
+    # Send from a separate thread, so a long pipeline cannot stall with both sides' buffers full
+    payload = "".join(query + "\n" for query in queries).encode()
+    sender = threading.Thread(target=client.sendall, args=(payload,), daemon=True)
+    sender.start()
+
+    reader = FrameReader(client)
+    for _ in queries:
+        sys.stdout.write(reader.read_frame())
+    client.close()
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())